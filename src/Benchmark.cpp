@@ -0,0 +1,171 @@
+#include "Benchmark.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "ofMain.h"
+#include "Lighting.h"
+#include "MeshBuilders.h"
+#include "Noise.h"
+#include "PRamp.h"
+
+bool Benchmark::save(const std::string& path) const {
+	std::ofstream f(path);
+	if(!f) return false;
+	f << "name,items,ns_per_item\n";
+	for(auto& r : mResults) f << r.name << "," << r.items << "," << r.nsPerItem << "\n";
+	return bool(f);
+}
+
+std::vector<Benchmark::Result> Benchmark::load(const std::string& path){
+	std::vector<Result> res;
+	std::ifstream f(path);
+	std::string line;
+	std::getline(f, line); // header
+	while(std::getline(f, line)){
+		std::istringstream ss(line);
+		Result r;
+		std::string items, ns;
+		if(std::getline(ss, r.name, ',') && std::getline(ss, items, ',') && std::getline(ss, ns)){
+			r.items = std::stoul(items);
+			r.nsPerItem = std::stod(ns);
+			res.push_back(r);
+		}
+	}
+	return res;
+}
+
+int Benchmark::compare(const std::vector<Result>& baseline, double tolerance) const {
+	int regressions = 0;
+	std::printf("%-28s %12s %12s %8s\n", "benchmark", "ns/item", "baseline", "ratio");
+	for(auto& r : mResults){
+		auto b = std::find_if(baseline.begin(), baseline.end(), [&](const Result& b){ return b.name == r.name; });
+		if(b == baseline.end() || b->nsPerItem <= 0.){
+			std::printf("%-28s %12.2f %12s %8s\n", r.name.c_str(), r.nsPerItem, "-", "new");
+			continue;
+		}
+		double ratio = r.nsPerItem / b->nsPerItem;
+		bool slow = ratio > tolerance;
+		regressions += slow;
+		std::printf("%-28s %12.2f %12.2f %7.2fx%s\n", r.name.c_str(), r.nsPerItem, b->nsPerItem, ratio, slow ? " REGRESSED" : "");
+	}
+	return regressions;
+}
+
+
+// Standalone benchmark program (graphics_finalProj_bench)
+
+// Built as its own target with only the CPU code under test, so it links no
+// window or GL setup and none of the app's allocation counting. Results are
+// written to bench.csv in the data folder and compared to bench_baseline.csv;
+// with no baseline yet, or with --update-baseline, they become the baseline.
+// Exits nonzero if any benchmark regressed.
+int main(int argc, char* argv[]){
+	bool updateBaseline = false;
+	for(int i=1; i<argc; ++i) updateBaseline = updateBaseline || std::string(argv[i]) == "--update-baseline";
+
+	Benchmark bench;
+	ofSeedRandom(1);
+
+	//PRamp: a bank of ramps at assorted frequencies, as the scene animations use
+	{
+		std::vector<PRamp> ramps(1<<14);
+		for(auto& r : ramps) r.freq(ofRandom(0.05, 4.)).phase(ofRandom(1.));
+		bench.run("pramp.update", ramps.size(), [&]{
+			for(auto& r : ramps) r.update(1./60);
+			return ramps[0].phase();
+		});
+		bench.run("pramp.tri", ramps.size(), [&]{
+			float sum = 0.;
+			for(auto& r : ramps) sum += r.tri();
+			return sum;
+		});
+		bench.run("pramp.para", ramps.size(), [&]{
+			float sum = 0.;
+			for(auto& r : ramps) sum += r.para();
+			return sum;
+		});
+	}
+
+	//Mesh builders: addRect recolours the whole mesh per call, so ns/rect grows with the mesh
+	for(int n : {64, 256, 1024}){
+		bench.run("addRect." + ofToString(n), n, [&]{
+			ofMesh m;
+			for(int i=0; i<n; ++i) addRect(ofFloatColor(1, 0, 0), m, glm::vec3(i, 0, 0), 0, 0);
+			return m.getNumColors();
+		});
+	}
+	bench.run("addQuad", 1024, [&]{
+		size_t verts = 0;
+		for(int i=0; i<1024; ++i){
+			ofMesh m;
+			addQuad(m, glm::vec3(1.5, -0.6, -1.5), glm::vec3(-1.5, -0.6, -1.5), glm::vec3(-1.5, 1.5, -1.5), glm::vec3(1.5, 1.5, -1.5), ofFloatColor(1, 1, 1));
+			verts += m.getNumVertices();
+		}
+		return verts;
+	});
+
+	//Noise texture, as in setup() at a quarter of the size
+	{
+		ofPixels pix;
+		pix.allocate(128, 128, OF_PIXELS_GRAY);
+		bench.run("noise.fbm6", pix.size(), [&]{
+			fbmNoise(pix);
+			return pix[pix.size()/2];
+		});
+	}
+
+	//Lighting: all scene lights on random surface points
+	{
+		int N = 4096;
+		std::vector<glm::vec3> pos(N), nrm(N);
+		for(int i=0; i<N; ++i){
+			pos[i] = glm::vec3(ofRandom(-1.5, 1.5), ofRandom(-0.6, 1.5), ofRandom(-1.5, 1.5));
+			nrm[i] = glm::normalize(glm::vec3(ofRandom(-1, 1), ofRandom(-1, 1), ofRandom(-1, 1)) + glm::vec3(0, 0, 1e-3));
+		}
+		lighting::Light lights[3] = { lighting::sceneLight(0), lighting::sceneLight(1), lighting::sceneLight(2) };
+		lighting::Material mt;
+		mt.diffuse = glm::vec3(1., 0.9, 0.8);
+		mt.specular = glm::vec3(0.5);
+		mt.shine = 20.;
+		glm::vec3 eye(0., 0.5, 3.);
+		bench.run("lighting.computeLightFall", N, [&]{
+			glm::vec3 sum(0.);
+			for(int i=0; i<N; ++i){
+				lighting::LightFall f{glm::vec3(0.), glm::vec3(0.)};
+				for(auto& lt : lights) lighting::addTo(f, lighting::computeLightFall(pos[i], nrm[i], eye, lt, mt));
+				sum += lighting::lightColor(f, mt);
+			}
+			return sum.x + sum.y + sum.z;
+		});
+
+		//Batch diffuse form used by the lightmap baker, on the same points
+		lighting::SurfacePoints pts;
+		pts.resize(N);
+		for(int i=0; i<N; ++i){
+			pts.px[i] = pos[i].x; pts.py[i] = pos[i].y; pts.pz[i] = pos[i].z;
+			pts.nx[i] = nrm[i].x; pts.ny[i] = nrm[i].y; pts.nz[i] = nrm[i].z;
+		}
+		std::vector<float> r(N), g(N), b(N);
+		bench.run("lighting.addDiffuseFall", N, [&]{
+			std::fill(r.begin(), r.end(), 0.f);
+			std::fill(g.begin(), g.end(), 0.f);
+			std::fill(b.begin(), b.end(), 0.f);
+			for(auto& lt : lights) lighting::addDiffuseFall(pts, 0, N, lt, r.data(), g.data(), b.data());
+			return r[0] + g[N/2] + b[N-1];
+		});
+	}
+
+	auto resultsPath = ofToDataPath("bench.csv", true);
+	auto baselinePath = ofToDataPath("bench_baseline.csv", true);
+	bench.save(resultsPath);
+	auto baseline = Benchmark::load(baselinePath);
+	int regressions = bench.compare(baseline);
+
+	if(baseline.empty() || updateBaseline){
+		bench.save(baselinePath);
+		std::printf("baseline written to %s\n", baselinePath.c_str());
+		return 0;
+	}
+	if(regressions) std::printf("%d benchmark(s) regressed\n", regressions);
+	return regressions ? 1 : 0;
+}
@@ -0,0 +1,80 @@
+#ifndef INC_BENCHMARK_H
+#define INC_BENCHMARK_H
+
+#include <algorithm> // max, min
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Timing of CPU code paths against a stored baseline
+
+// Each benchmark is a function processing a known number of items; it is
+// timed as the fastest of several samples and reported in nanoseconds per
+// item. Results are saved as CSV (name,items,ns_per_item) and compared to a
+// baseline file; a result slower than the baseline by more than the tolerance
+// counts as a regression.
+class Benchmark{
+public:
+
+	struct Result{
+		std::string name;
+		size_t items = 0;
+		double nsPerItem = 0.;
+	};
+
+	/// Time a function
+
+	/// @param[in] name		Unique name of the benchmark, without commas
+	/// @param[in] items	Number of items one call of fn processes
+	/// @param[in] fn		Function to time; its return value is kept so the work is not optimised away
+	/// @param[in] samples	Number of samples; the fastest is kept
+	template <class Func>
+	const Result& run(const std::string& name, size_t items, const Func& fn, int samples = 7){
+		typedef std::chrono::steady_clock clock;
+		// Warm up and size samples to at least minSampleMs
+		auto t0 = clock::now();
+		mSink = mSink + double(fn());
+		double once = std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+		int calls = std::max(1, int(minSampleMs * 1e6 / std::max(once, 1.)));
+
+		double best = 1e300;
+		for(int s=0; s<samples; ++s){
+			t0 = clock::now();
+			for(int c=0; c<calls; ++c) mSink = mSink + double(fn());
+			double ns = std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+			best = std::min(best, ns / calls);
+		}
+
+		Result r;
+		r.name = name;
+		r.items = items;
+		r.nsPerItem = best / std::max(items, size_t(1));
+		mResults.push_back(r);
+		return mResults.back();
+	}
+
+	const std::vector<Result>& results() const { return mResults; }
+
+	// Write results as CSV
+	bool save(const std::string& path) const;
+
+	// Read results from CSV; empty if the file is missing
+	static std::vector<Result> load(const std::string& path);
+
+	/// Print results next to a baseline
+
+	/// @param[in] baseline		Results to compare to; names missing from it are reported as new
+	/// @param[in] tolerance	Largest allowed ratio of new to baseline time
+	/// @return number of regressions
+	int compare(const std::vector<Result>& baseline, double tolerance = 1.25) const;
+
+	// Shortest time one sample should take, in milliseconds
+	double minSampleMs = 20.;
+
+private:
+	std::vector<Result> mResults;
+	volatile double mSink = 0.;
+};
+
+
+#endif // include guard
@@ -0,0 +1,122 @@
+#ifndef INC_DYNAMICRESOLUTION_H
+#define INC_DYNAMICRESOLUTION_H
+
+#include <algorithm> // min, max
+#include <chrono>
+#include <cmath> // pow, round
+#include <cstdint>
+#include "ofGLUtils.h" // GL headers
+#include "ofVectorMath.h"
+
+// Render scale controller holding a GPU frame-time budget
+
+// Time spent by the GPU between beginFrame() and endFrame() is measured with
+// timer queries, read back a few frames later so nothing stalls. The scale
+// follows the measured time with a damped feedback loop: it drops as soon as a
+// frame goes over budget and creeps back up only once there is clear headroom.
+// Without timer query support, the time is measured on the CPU after glFinish.
+class DynamicResolution{
+public:
+
+	~DynamicResolution(){
+		if(mQueries[0]) glDeleteQueries(numQueries, mQueries);
+	}
+
+	// Set frame budget, in milliseconds
+	DynamicResolution& budget(float ms){ mBudget = ms; return *this; }
+	float budget() const { return mBudget; }
+
+	// Set allowed range of scale, relative to window size
+	DynamicResolution& range(float minScale, float maxScale){
+		mMin = minScale; mMax = maxScale;
+		mScale = std::min(std::max(mScale, mMin), mMax);
+		return *this;
+	}
+
+	// Start timing the frame's GPU work
+	void beginFrame(){
+		if(!mInit) init();
+		if(mTimerQueries){
+			auto q = mQueries[mFrame % numQueries];
+			if(mFrame >= numQueries){
+				GLint ready = 0;
+				glGetQueryObjectiv(q, GL_QUERY_RESULT_AVAILABLE, &ready);
+				// Skip frames rendered before the last scale change took effect
+				if(ready && mFrame - numQueries >= mChangedAt){
+					GLuint64 ns = 0;
+					glGetQueryObjectui64v(q, GL_QUERY_RESULT, &ns);
+					measure(ns * 1e-6f);
+				}
+			}
+			glBeginQuery(GL_TIME_ELAPSED, q);
+		} else {
+			mStart = std::chrono::steady_clock::now();
+		}
+	}
+
+	// Stop timing the frame's GPU work and update the scale
+	void endFrame(){
+		if(mTimerQueries){
+			glEndQuery(GL_TIME_ELAPSED);
+		} else {
+			glFinish();
+			std::chrono::duration<float, std::milli> dt = std::chrono::steady_clock::now() - mStart;
+			measure(dt.count());
+		}
+		++mFrame;
+	}
+
+	// Get render scale, in [min, max]
+	float scale() const { return mScale; }
+	// Get smoothed GPU frame time, in milliseconds
+	float gpuMs() const { return mTime; }
+	// Whether GPU time comes from timer queries
+	bool timerQueries() const { return mTimerQueries; }
+
+	// Get internal render size for a window size, snapped to multiples of 8 to limit reallocation
+	glm::ivec2 size(int w, int h) const {
+		auto snap = [this](int v){ return std::max(8, int(std::round(v * mScale / 8.f)) * 8); };
+		return glm::ivec2(std::min(snap(w), w), std::min(snap(h), h));
+	}
+
+private:
+	static const int numQueries = 4; // frames of latency before reading a result
+
+	void init(){
+		mInit = true;
+		#ifndef TARGET_OPENGLES
+		mTimerQueries = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+		#endif
+		if(mTimerQueries) glGenQueries(numQueries, mQueries);
+	}
+
+	void measure(float ms){
+		float before = mScale;
+		mTime = mTime > 0.f ? mTime + 0.2f * (ms - mTime) : ms; // smooth out single-frame spikes
+		// GPU cost goes with pixel count, i.e. scale squared
+		float ratio = mBudget / std::max(mTime, 0.01f);
+		if(ms > mBudget){
+			mScale *= std::max(std::sqrt(mBudget / ms), 0.85f);
+			mStable = 0;
+		} else if(ratio > 1.25f && ++mStable > 20){
+			mScale *= std::min(std::pow(ratio, 0.25f), 1.05f);
+			mStable = 0;
+		}
+		mScale = std::min(std::max(mScale, mMin), mMax);
+		if(mScale != before) mChangedAt = mFrame; // with queries, this frame is the first at the new scale
+	}
+
+	GLuint mQueries[numQueries] = {0};
+	std::chrono::steady_clock::time_point mStart;
+	uint64_t mFrame = 0;
+	uint64_t mChangedAt = 0;	// frame of the last scale change
+	float mBudget = 25.f;
+	float mMin = 0.5f, mMax = 1.f;
+	float mScale = 1.f;
+	float mTime = 0.f;
+	int mStable = 0;
+	bool mInit = false;
+	bool mTimerQueries = false;
+};
+
+#endif // include guard
@@ -0,0 +1,96 @@
+#ifndef INC_FRAMEARENA_H
+#define INC_FRAMEARENA_H
+
+#include <algorithm> // max
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib> // malloc, free
+#include <new> // bad_alloc
+
+// Bump allocator for data that lives for one frame
+
+// Allocation is a pointer bump into one block; reset() at the start of a
+// frame releases everything at once. If a frame needs more than the block, the
+// extra comes from chained heap chunks and the block grows to the high-water
+// mark on the next reset, so after a frame or two the arena stops touching
+// the heap. Destructors are never run, so only store trivially destructible
+// data.
+class FrameArena{
+public:
+
+	explicit FrameArena(size_t bytes = 1<<16){ grow(bytes); }
+
+	~FrameArena(){
+		freeChunks();
+		std::free(mBlock);
+	}
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	// Get uninitialised memory valid until the next reset()
+	void * alloc(size_t bytes, size_t align = alignof(std::max_align_t)){
+		size_t at = (mUsed + align-1) & ~(align-1);
+		if(at + bytes <= mCapacity){
+			mUsed = at + bytes;
+			mPeak = std::max(mPeak, mUsed);
+			return mBlock + at;
+		}
+		// Overflow: chain a chunk so earlier pointers stay valid
+		mPeak = std::max(mPeak, mUsed) + bytes + align;
+		++mOverflows;
+		auto c = (Chunk *)std::malloc(sizeof(Chunk) + bytes + align);
+		if(!c) throw std::bad_alloc();
+		c->next = mChunks;
+		mChunks = c;
+		auto p = reinterpret_cast<uintptr_t>(c + 1);
+		return reinterpret_cast<void *>((p + align-1) & ~uintptr_t(align-1));
+	}
+
+	// Get an uninitialised array of n T's
+	template <class T>
+	T * make(size_t n){ return static_cast<T *>(alloc(n * sizeof(T), alignof(T))); }
+
+	// Release all allocations; grows the block if the last frame overflowed
+	void reset(){
+		if(mChunks){
+			freeChunks();
+			grow(mPeak);
+		}
+		mUsed = 0;
+	}
+
+	// Get bytes handed out since the last reset()
+	size_t used() const { return mUsed; }
+	// Get size of the block
+	size_t capacity() const { return mCapacity; }
+	// Get number of allocations that did not fit the block
+	size_t overflows() const { return mOverflows; }
+
+private:
+	struct alignas(std::max_align_t) Chunk{ Chunk * next; };
+
+	void grow(size_t bytes){
+		std::free(mBlock);
+		mCapacity = std::max(bytes, mCapacity);
+		mBlock = (char *)std::malloc(mCapacity);
+		if(!mBlock) throw std::bad_alloc();
+	}
+
+	void freeChunks(){
+		while(mChunks){
+			auto n = mChunks->next;
+			std::free(mChunks);
+			mChunks = n;
+		}
+	}
+
+	char * mBlock = nullptr;
+	Chunk * mChunks = nullptr;
+	size_t mCapacity = 0;
+	size_t mUsed = 0;
+	size_t mPeak = 0;
+	size_t mOverflows = 0;
+};
+
+#endif // include guard
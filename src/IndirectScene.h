@@ -0,0 +1,329 @@
+#ifndef INC_INDIRECTSCENE_H
+#define INC_INDIRECTSCENE_H
+
+#include <algorithm> // max
+#include <cstddef> // offsetof
+#include <cstdint>
+#include <numeric> // iota
+#include <string>
+#include <vector>
+#include "ofGLUtils.h" // GL headers
+#include "ofShader.h" // attribute locations
+#include "ofTexture.h"
+#include "ofVectorMath.h"
+#include "MeshOptimizer.h"
+
+/*
+Multi-draw indirect rendering from one merged geometry buffer (GL 4.3).
+
+The parts of every OptimizedModel are copied into one vertex and one index
+buffer behind one VAO, so the whole scene draws without rebinding vertex
+state. Each frame, draws are listed as commands (index range and base
+vertex of a part) with per-draw data (transform and material) and submitted
+with a single glMultiDrawElementsIndirect.
+
+A draw finds its data through its base instance: an instanced vertex
+attribute holding 0, 1, 2, ... is read at index baseInstance, and the
+shader uses it to index the draw buffer. Commands and draw data are plain
+GPU arrays, so generating and culling them can later move into a compute
+pass without changing how they are drawn.
+*/
+class IndirectScene{
+public:
+
+	// Per-draw data, std430 layout (binding 0)
+	struct Draw{
+		glm::mat4 model;
+		glm::vec4 diffuse;		// rgb, a = texture layer or -1 for none
+		glm::vec4 material;		// x = shininess, y = reflectivity
+	};
+
+	IndirectScene(){}
+	IndirectScene(const IndirectScene&) = delete;
+	IndirectScene& operator=(const IndirectScene&) = delete;
+	~IndirectScene(){ clear(); }
+
+	// Whether the GL context has multi-draw indirect and storage buffers
+
+	// GL 4.3 only requires storage blocks in fragment and compute shaders, so
+	// the vertex stage, which reads the draw buffer, is checked separately.
+	static bool supported(){
+		#ifndef TARGET_OPENGLES
+		if(!GLEW_VERSION_4_3) return false;
+		GLint vertexBlocks = 0;
+		glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexBlocks);
+		return vertexBlocks > 0;
+		#else
+		return false;
+		#endif
+	}
+
+	// Add a model's parts to the merged buffers
+
+	// Buffers are rebuilt on the next upload().
+	/// @return mesh id to draw the model with, or -1 if it has no parts
+	int add(const OptimizedModel& model){
+		if(model.empty()) return -1;
+		Mesh mesh;
+		mesh.firstPart = int(mParts.size());
+		for(auto& p : model.parts()){
+			Part part;
+			part.matrix = model.modelMatrix() * p.matrix;
+			part.source = &p;
+			mParts.push_back(part);
+		}
+		mesh.numParts = int(mParts.size()) - mesh.firstPart;
+		mMeshes.push_back(mesh);
+		return int(mMeshes.size()) - 1;
+	}
+
+	// Merge the added models' buffers; the models must still be alive
+	bool upload(){
+		if(!supported() || mParts.empty()) return false;
+
+		// 16-bit indices suffice if every part's do, since base vertex offsets them
+		bool shortIndex = true;
+		GLsizei numVerts = 0, numIndices = 0;
+		for(auto& p : mParts){
+			shortIndex = shortIndex && p.source->indexType == GL_UNSIGNED_SHORT;
+			p.count = p.source->count;
+			p.firstIndex = numIndices;
+			p.baseVertex = numVerts;
+			numIndices += p.source->count;
+			numVerts += p.source->verts;
+		}
+		mIndexType = shortIndex ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		size_t indexSize = shortIndex ? 2 : 4;
+
+		// Read back the parts' buffers; done once, so the copy through memory is fine
+		std::vector<meshopt::PackedVertex> verts(numVerts);
+		std::vector<uint8_t> indices(numIndices * indexSize);
+		std::vector<uint16_t> idx16;
+		for(auto& p : mParts){
+			auto& s = *p.source;
+			glBindBuffer(GL_COPY_READ_BUFFER, s.vbo);
+			glGetBufferSubData(GL_COPY_READ_BUFFER, 0, s.verts * sizeof(meshopt::PackedVertex), &verts[p.baseVertex]);
+			glBindBuffer(GL_COPY_READ_BUFFER, s.ibo);
+			auto dst = &indices[p.firstIndex * indexSize];
+			if(shortIndex || s.indexType == GL_UNSIGNED_INT){
+				glGetBufferSubData(GL_COPY_READ_BUFFER, 0, s.count * indexSize, dst);
+			} else { // widen
+				idx16.resize(s.count);
+				glGetBufferSubData(GL_COPY_READ_BUFFER, 0, s.count * 2, idx16.data());
+				auto dst32 = (uint32_t *)dst;
+				for(GLsizei i=0; i<s.count; ++i) dst32[i] = idx16[i];
+			}
+		}
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+		clearBuffers();
+		glGenVertexArrays(1, &mVAO);
+		glBindVertexArray(mVAO);
+		glGenBuffers(1, &mVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+		glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(meshopt::PackedVertex), verts.data(), GL_STATIC_DRAW);
+		glGenBuffers(1, &mIBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size(), indices.data(), GL_STATIC_DRAW);
+
+		auto stride = GLsizei(sizeof(meshopt::PackedVertex));
+		glEnableVertexAttribArray(ofShader::POSITION_ATTRIBUTE);
+		glVertexAttribPointer(ofShader::POSITION_ATTRIBUTE, 3, GL_SHORT, GL_TRUE, stride, (void *)offsetof(meshopt::PackedVertex, pos));
+		glEnableVertexAttribArray(ofShader::NORMAL_ATTRIBUTE);
+		glVertexAttribPointer(ofShader::NORMAL_ATTRIBUTE, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void *)offsetof(meshopt::PackedVertex, normal));
+		glEnableVertexAttribArray(ofShader::TEXCOORD_ATTRIBUTE);
+		glVertexAttribPointer(ofShader::TEXCOORD_ATTRIBUTE, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void *)offsetof(meshopt::PackedVertex, uv));
+
+		glGenBuffers(1, &mDrawIndexBuffer);
+		glGenBuffers(1, &mCommandBuffer);
+		glGenBuffers(1, &mDrawBuffer);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return true;
+	}
+
+	// Start a new list of draws
+	void begin(){
+		mCommands.clear();
+		mDraws.clear();
+	}
+
+	// List the parts of a mesh with a transform and material
+	void add(int mesh, const glm::mat4& transform, const glm::vec4& diffuse, const glm::vec4& material){
+		if(mesh < 0 || mesh >= int(mMeshes.size())) return;
+		auto& m = mMeshes[mesh];
+		for(int i=m.firstPart; i<m.firstPart+m.numParts; ++i){
+			auto& p = mParts[i];
+			Command c;
+			c.count = p.count;
+			c.firstIndex = p.firstIndex;
+			c.baseVertex = p.baseVertex;
+			c.baseInstance = GLuint(mDraws.size());
+			mCommands.push_back(c);
+			mDraws.push_back({transform * p.matrix, diffuse, material});
+		}
+	}
+
+	// Submit the listed draws with one call, each instanced n times
+	void draw(int instances = 1){
+		if(!mVAO || mCommands.empty()) return;
+		for(auto& c : mCommands) c.instanceCount = instances;
+
+		glBindVertexArray(mVAO);
+
+		// Instanced attribute 0, 1, 2, ... read at each command's base instance
+		if(mDraws.size() > mDrawIndexCapacity){
+			mDrawIndexCapacity = std::max(mDraws.size(), mDrawIndexCapacity * 2);
+			std::vector<GLuint> ids(mDrawIndexCapacity);
+			std::iota(ids.begin(), ids.end(), 0u);
+			glBindBuffer(GL_ARRAY_BUFFER, mDrawIndexBuffer);
+			glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+			glEnableVertexAttribArray(drawIndexAttribute);
+			glVertexAttribIPointer(drawIndexAttribute, 1, GL_UNSIGNED_INT, 0, nullptr);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		glVertexAttribDivisor(drawIndexAttribute, instances); // all instances of a draw read the same index
+
+		// Orphan and refill, so the GPU never waits on last frame's data
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mDrawBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, mDraws.size() * sizeof(Draw), mDraws.data(), GL_STREAM_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mDrawBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, mCommands.size() * sizeof(Command), mCommands.data(), GL_STREAM_DRAW);
+
+		glMultiDrawElementsIndirect(GL_TRIANGLES, mIndexType, nullptr, GLsizei(mCommands.size()), 0);
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		glBindVertexArray(0);
+	}
+
+	// Get number of draws listed since begin()
+	size_t size() const { return mCommands.size(); }
+	bool empty() const { return mMeshes.empty(); }
+
+	void clear(){
+		clearBuffers();
+		mMeshes.clear();
+		mParts.clear();
+		begin();
+	}
+
+	// Vertex attribute location of the per-draw index
+	static const GLuint drawIndexAttribute = 4;
+
+	// Get GLSL declaration of the draw buffer, for shaders defining INDIRECT
+	static std::string glsl(){
+		return R"(
+		#ifdef INDIRECT
+		struct Draw
+			{
+				mat4 model;
+				vec4 diffuse; // rgb, a = texture layer or -1 for none
+				vec4 material; // x = shininess, y = reflectivity
+			};
+		layout ( std430 , binding = 0 ) readonly buffer Draws { Draw draws[]; };
+		#endif
+		)";
+	}
+
+private:
+	// Layout fixed by GL
+	struct Command{
+		GLuint count = 0;
+		GLuint instanceCount = 1;
+		GLuint firstIndex = 0;
+		GLint baseVertex = 0;
+		GLuint baseInstance = 0;
+	};
+
+	struct Part{
+		glm::mat4 matrix;	// model and part transform
+		const OptimizedModel::Part * source = nullptr; // until upload
+		GLsizei count = 0;
+		GLsizei firstIndex = 0;
+		GLint baseVertex = 0;
+	};
+
+	struct Mesh{
+		int firstPart = 0;
+		int numParts = 0;
+	};
+
+	void clearBuffers(){
+		if(!mVAO) return;
+		glDeleteVertexArrays(1, &mVAO);
+		GLuint buffers[] = { mVBO, mIBO, mDrawIndexBuffer, mCommandBuffer, mDrawBuffer };
+		glDeleteBuffers(5, buffers);
+		mVAO = mVBO = mIBO = mDrawIndexBuffer = mCommandBuffer = mDrawBuffer = 0;
+		mDrawIndexCapacity = 0;
+	}
+
+	std::vector<Mesh> mMeshes;
+	std::vector<Part> mParts;
+	std::vector<Command> mCommands;
+	std::vector<Draw> mDraws;
+	GLuint mVAO = 0, mVBO = 0, mIBO = 0;
+	GLuint mDrawIndexBuffer = 0, mCommandBuffer = 0, mDrawBuffer = 0;
+	size_t mDrawIndexCapacity = 0;
+	GLenum mIndexType = GL_UNSIGNED_INT;
+};
+
+
+// 2D textures resampled into one texture array, so draws can pick a layer
+class TextureArray{
+public:
+
+	~TextureArray(){ clear(); }
+
+	// Copy textures into layers of a size x size array, with mipmaps
+	bool build(const std::vector<ofTexture *>& layers, int size){
+		clear();
+		if(layers.empty()) return false;
+		int levels = 1;
+		while((size >> levels) > 0) ++levels;
+		glGenTextures(1, &mID);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, mID);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGB8, size, size, GLsizei(layers.size()));
+		for(int l=0; l<levels; ++l) mBytes += size_t(size >> l) * (size >> l) * 3 * layers.size();
+
+		// Blit each texture into its layer, scaling to fit
+		GLuint fbos[2];
+		glGenFramebuffers(2, fbos);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, fbos[0]);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[1]);
+		for(size_t i=0; i<layers.size(); ++i){
+			auto& t = layers[i]->getTextureData();
+			glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, t.textureTarget, t.textureID, 0);
+			glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, mID, 0, GLint(i));
+			glBlitFramebuffer(0, 0, t.width, t.height, 0, 0, size, size, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(2, fbos);
+
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		// Quantised texcoords are clamped to [0,1], so sample as the 2D textures do
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		return true;
+	}
+
+	GLuint id() const { return mID; }
+	// Get GPU size, in bytes, mipmaps included
+	size_t bytes() const { return mBytes; }
+
+	void clear(){
+		if(mID) glDeleteTextures(1, &mID);
+		mID = 0;
+		mBytes = 0;
+	}
+
+private:
+	GLuint mID = 0;
+	size_t mBytes = 0;
+};
+
+#endif // include guard
@@ -0,0 +1,130 @@
+#ifndef INC_LIGHTING_H
+#define INC_LIGHTING_H
+
+#include <algorithm> // max
+#include <cmath> // pow, sqrt
+#include <vector>
+#include "ofVectorMath.h"
+
+// CPU version of the lit shader's lighting model
+
+// Mirrors glslLighting() and sceneLight() in ofApp.cpp term for term, so
+// results can be checked or baked on the CPU. Keep the two in step.
+namespace lighting{
+
+struct Light{
+	glm::vec3 pos;
+	float strength;
+	float halfDist;
+	float ambient;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+};
+
+struct Material{
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+	float shine;
+};
+
+struct LightFall{
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+};
+
+// In-place addition: a += b
+inline void addTo(LightFall& a, const LightFall& b){
+	a.diffuse += b.diffuse;
+	a.specular += b.specular;
+}
+
+// Compute light components falling on surface
+inline LightFall computeLightFall(const glm::vec3& pos, const glm::vec3& N, const glm::vec3& eye, const Light& lt, const Material& mt){
+	glm::vec3 lightDist = lt.pos - pos;
+	float hh = lt.halfDist * lt.halfDist;
+	float atten = lt.strength * hh / (hh + glm::dot(lightDist, lightDist));
+	glm::vec3 L = glm::normalize(lightDist);
+	// diffuse
+	float d = std::max(glm::dot(N, L), 0.f);
+	d += lt.ambient;
+	// specular
+	glm::vec3 V = glm::normalize(eye - pos);
+	glm::vec3 H = glm::normalize(L + V);
+	float s = std::pow(std::max(glm::dot(N, H), 0.f), mt.shine);
+	LightFall fall;
+	fall.diffuse = lt.diffuse * (d * atten);
+	fall.specular = lt.specular * (s * atten);
+	return fall;
+}
+
+// Get final color reflected off material
+inline glm::vec3 lightColor(const LightFall& f, const Material& mt){
+	return f.diffuse * mt.diffuse + f.specular * mt.specular;
+}
+
+// Get one of the scene's three lights
+inline Light sceneLight(int i){
+	// First light, white, top right corner
+	Light light1;
+	light1.pos = glm::vec3(0.5, 1.5, -0.5);
+	light1.strength = 1.5;
+	light1.halfDist = 1.;
+	light1.ambient = 0.8;
+	light1.diffuse = glm::vec3(1., 1., 1.);
+	light1.specular = light1.diffuse;
+	if(i == 0) return light1;
+
+	// Second light, blue, bottom right corner
+	Light light2 = light1;
+	light2.pos = glm::vec3(0., -0.95, 0.);
+	light2.diffuse = glm::vec3(0., 0., 1.);
+	light2.specular = light2.diffuse;
+	if(i == 1) return light2;
+
+	// Third light, white, bottom left corner
+	Light light3 = light1;
+	light3.strength = 0.7;
+	light3.pos = glm::vec3(-0.7, -0.6, 0.);
+	light3.diffuse = glm::vec3(1., 1., 1.);
+	light3.specular = light1.diffuse;
+	return light3;
+}
+
+// Surface points in structure-of-arrays form, for batch evaluation
+struct SurfacePoints{
+	std::vector<float> px, py, pz;	// position
+	std::vector<float> nx, ny, nz;	// unit normal
+	std::vector<float> ambient;		// ambient scale, e.g. occlusion; 1 = open
+
+	void resize(size_t n){
+		for(auto * v : {&px, &py, &pz, &nx, &ny, &nz}) v->resize(n);
+		ambient.resize(n, 1.f);
+	}
+	size_t size() const { return px.size(); }
+};
+
+// Add the diffuse part of computeLightFall for points [begin, end) to r, g, b
+
+// Written as one flat loop over arrays so the compiler can vectorise it.
+// Specular depends on the eye, so it has no batch form here.
+inline void addDiffuseFall(const SurfacePoints& s, size_t begin, size_t end, const Light& lt, float * r, float * g, float * b){
+	const float * px = s.px.data(), * py = s.py.data(), * pz = s.pz.data();
+	const float * nx = s.nx.data(), * ny = s.ny.data(), * nz = s.nz.data();
+	const float * amb = s.ambient.data();
+	float hh = lt.halfDist * lt.halfDist;
+	for(size_t i=begin; i<end; ++i){
+		float lx = lt.pos.x - px[i], ly = lt.pos.y - py[i], lz = lt.pos.z - pz[i];
+		float dd = lx*lx + ly*ly + lz*lz;
+		float atten = lt.strength * hh / (hh + dd);
+		float d = std::max((nx[i]*lx + ny[i]*ly + nz[i]*lz) / std::sqrt(dd), 0.f);
+		d += lt.ambient * amb[i];
+		float k = d * atten;
+		r[i] += lt.diffuse.r * k;
+		g[i] += lt.diffuse.g * k;
+		b[i] += lt.diffuse.b * k;
+	}
+}
+
+} // lighting::
+
+#endif // include guard
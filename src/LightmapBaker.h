@@ -0,0 +1,470 @@
+#ifndef INC_LIGHTMAPBAKER_H
+#define INC_LIGHTMAPBAKER_H
+
+#include <algorithm> // min, max
+#include <atomic>
+#include <chrono>
+#include <cmath> // floor, ceil, sqrt, sin, cos
+#include <cstdint>
+#include <cstdio> // snprintf
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ofFileUtils.h" // ofDirectory, ofToDataPath
+#include "ofImage.h" // ofLoadImage, ofSaveImage
+#include "ofMesh.h"
+#include "ofTexture.h"
+#include "Lighting.h"
+
+/*
+Baked diffuse lighting for static surfaces.
+
+Each surface is a set of world-space triangles plus a planar projection that
+maps world positions to lightmap coordinates (xy) and to a depth toward the
+surface's lit side (z). Triangles are rasterised at texel centres, the
+frontmost winning where they overlap, and the diffuse part of the lit
+shader's lighting (Lighting.h) is evaluated for every covered texel in
+structure-of-arrays batches spread over all cores. Optionally the ambient
+term is scaled by ambient occlusion, found by marching rays through a
+voxelisation of occluder meshes.
+
+Specular light depends on the eye, so it is not baked; a lightmapped
+surface shows the baked light times its texture colour. A surface can be
+limited to triangles facing its projection's front; shaders then use the
+lightmap only where the visible side faces that way and light the rest live.
+
+Lightmaps are cached as 16-bit PNGs named by a hash of every input, so a bake
+only runs when geometry, lights or settings change.
+*/
+class LightmapBaker{
+public:
+
+	// Baked light is stored over [0, range]
+	static constexpr float range = 4.f;
+	// Smallest cosine between a limited surface's normal and its projection's front
+	static constexpr float minFacing = 0.7f;
+
+	// Get GLSL declarations for shaders sampling the lightmaps
+	static std::string glsl(){
+		return "\n\tconst float lightmapRange = " + std::to_string(range) + ";\n"
+			"\tconst float lightmapMinFacing = " + std::to_string(minFacing) + ";\n";
+	}
+
+	/// Get projection onto a rectangle
+
+	/// @param[in] origin	World position of lightmap coordinate (0,0)
+	/// @param[in] uEdge	World vector from origin to coordinate (1,0)
+	/// @param[in] vEdge	World vector from origin to coordinate (0,1), perpendicular to uEdge
+	/// @param[in] front	Direction the lit side faces
+	static glm::mat4 planar(const glm::vec3& origin, const glm::vec3& uEdge, const glm::vec3& vEdge, const glm::vec3& front){
+		auto u = uEdge / glm::dot(uEdge, uEdge);
+		auto v = vEdge / glm::dot(vEdge, vEdge);
+		auto f = glm::normalize(front);
+		// Rows u, v, f; glm is column-major
+		glm::mat4 m(1.f);
+		m[0] = glm::vec4(u.x, v.x, f.x, 0.f);
+		m[1] = glm::vec4(u.y, v.y, f.y, 0.f);
+		m[2] = glm::vec4(u.z, v.z, f.z, 0.f);
+		m[3] = glm::vec4(-glm::dot(u, origin), -glm::dot(v, origin), -glm::dot(f, origin), 1.f);
+		return m;
+	}
+
+	/// Add a surface to bake
+
+	/// @param[in] name		Unique name, used for its cache file
+	/// @param[in] size		Lightmap width and height, in texels
+	/// @param[in] facing	Only bake triangles facing the projection's front by at least minFacing
+	/// @return index of the surface
+	int add(const std::string& name, int size, bool facing = false){
+		mSurfaces.emplace_back();
+		mSurfaces.back().name = name;
+		mSurfaces.back().size = size;
+		mSurfaces.back().facing = facing;
+		return int(mSurfaces.size()) - 1;
+	}
+
+	// Add a mesh's triangles to a surface
+
+	// Normals are lit untransformed, as the lit shader uses them; their world
+	// direction only decides which triangles face the front.
+	void addMesh(int surface, const ofMesh& mesh, const glm::mat4& transform){
+		auto& s = mSurfaces[surface];
+		auto normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+		triangles(mesh, [&](int i){
+			auto n = mesh.hasNormals() ? mesh.getNormal(i) : glm::vec3(0.f);
+			s.positions.push_back(glm::vec3(transform * glm::vec4(mesh.getVertex(i), 1.f)));
+			s.normals.push_back(n);
+			s.worldNormals.push_back(normalMatrix * n);
+		});
+	}
+
+	// Set the projection of a surface from world space to its lightmap
+	void project(int surface, const glm::mat4& projection){ mSurfaces[surface].projection = projection; }
+
+	// Project a surface from above, fitted to its bounds in x and z
+	void projectTopDown(int surface){
+		auto& s = mSurfaces[surface];
+		glm::vec3 lo(std::numeric_limits<float>::max()), hi(-lo);
+		for(auto& p : s.positions){
+			lo = glm::min(lo, p);
+			hi = glm::max(hi, p);
+		}
+		auto ext = glm::max(hi - lo, glm::vec3(1e-6f));
+		project(surface, planar(lo, glm::vec3(ext.x, 0., 0.), glm::vec3(0., 0., ext.z), glm::vec3(0., 1., 0.)));
+	}
+
+	// Add a mesh that occludes ambient light
+	void addOccluder(const ofMesh& mesh, const glm::mat4& transform){
+		triangles(mesh, [&](int i){
+			mOccluders.push_back(glm::vec3(transform * glm::vec4(mesh.getVertex(i), 1.f)));
+		});
+	}
+
+	// Set lights
+	LightmapBaker& lights(const std::vector<lighting::Light>& v){ mLights = v; return *this; }
+
+	/// Set ambient occlusion
+
+	/// @param[in] rays		Rays per texel; 0 turns occlusion off
+	/// @param[in] radius	Distance within which occluders darken, in world units
+	/// @param[in] voxels	Voxel grid resolution along its longest side
+	LightmapBaker& occlusion(int rays, float radius, int voxels = 128){
+		mRays = rays;
+		mRadius = radius;
+		mVoxelRes = voxels;
+		return *this;
+	}
+
+	/// Bake all surfaces, or load them from the cache, and upload them
+
+	/// @param[in] cacheDir	Folder for cached lightmaps, relative to the data folder
+	/// @return whether every surface has a lightmap
+	bool bake(const std::string& cacheDir){
+		auto dir = ofToDataPath(cacheDir, true);
+		ofDirectory::createDirectory(dir, false, true);
+		char id[24];
+		std::snprintf(id, sizeof id, "%016llx", (unsigned long long)hash());
+
+		bool ok = true;
+		size_t texels = 0;
+		auto t0 = std::chrono::steady_clock::now();
+		Voxels voxels;
+		bool voxelised = false;
+		for(auto& s : mSurfaces){
+			auto path = dir + "/" + s.name + "-" + id + ".png";
+			if(!load(s, path)){
+				if(!voxelised) voxels = voxelise();
+				voxelised = true;
+				texels += bake(s, voxels);
+				removeStale(dir, s.name, s.name + "-" + id + ".png");
+				ok = ofSaveImage(s.pixels, path) && ok;
+			}
+			s.texture.loadData(s.pixels);
+			s.texture.setTextureWrap(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+			s.texture.setTextureMinMagFilter(GL_LINEAR, GL_LINEAR);
+		}
+		std::chrono::duration<double, std::milli> dt = std::chrono::steady_clock::now() - t0;
+		if(texels) std::cout << " Lightmaps: baked " << texels << " texels in " << int(dt.count()) << " ms on " << threads() << " threads" << std::endl;
+		else std::cout << " Lightmaps: " << mSurfaces.size() << " loaded from cache" << std::endl;
+		return ok;
+	}
+
+	// Remove all surfaces, occluders and lights
+	void clear(){
+		mSurfaces.clear();
+		mOccluders.clear();
+		mLights.clear();
+	}
+
+	size_t size() const { return mSurfaces.size(); }
+	// Get lightmap of a surface
+	const ofTexture& texture(int i) const { return mSurfaces[i].texture; }
+	// Get projection of a surface from world space to its lightmap
+	const glm::mat4& projection(int i) const { return mSurfaces[i].projection; }
+
+private:
+	struct Surface{
+		std::string name;
+		int size = 128;
+		glm::mat4 projection{1.f};
+		std::vector<glm::vec3> positions;	// world space, three per triangle
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec3> worldNormals;
+		bool facing = false;				// only triangles facing the front
+		ofShortPixels pixels;				// baked light over range, RGB
+		ofTexture texture;
+	};
+
+	// Occupancy grid of the occluders
+	struct Voxels{
+		glm::vec3 lo{0.f}, hi{0.f};
+		float cell = 1.f;
+		glm::ivec3 dim{0};
+		std::vector<uint8_t> solid;
+
+		bool empty() const { return solid.empty(); }
+		bool at(const glm::vec3& p) const {
+			auto c = glm::ivec3(glm::floor((p - lo) / cell));
+			if(c.x < 0 || c.y < 0 || c.z < 0 || c.x >= dim.x || c.y >= dim.y || c.z >= dim.z) return false;
+			return solid[(size_t(c.z) * dim.y + c.y) * dim.x + c.x];
+		}
+	};
+
+	// Call f with the vertex indices of every triangle of a mesh
+	template <class Func>
+	static void triangles(const ofMesh& mesh, const Func& f){
+		if(mesh.getMode() != OF_PRIMITIVE_TRIANGLES) return;
+		if(mesh.hasIndices()){
+			size_t n = mesh.getNumIndices() / 3 * 3;
+			for(size_t i=0; i<n; ++i) f(mesh.getIndex(i));
+		} else {
+			size_t n = mesh.getNumVertices() / 3 * 3;
+			for(size_t i=0; i<n; ++i) f(int(i));
+		}
+	}
+
+	static unsigned threads(){ return std::max(1u, std::thread::hardware_concurrency()); }
+
+	// Run f(begin, end) over [0, n) in chunks on all cores
+	template <class Func>
+	static void parallelFor(size_t n, size_t chunk, const Func& f){
+		std::atomic<size_t> next{0};
+		auto work = [&]{
+			for(size_t b; (b = next.fetch_add(chunk)) < n;) f(b, std::min(b + chunk, n));
+		};
+		std::vector<std::thread> pool;
+		for(unsigned i=1; i<threads(); ++i) pool.emplace_back(work);
+		work();
+		for(auto& t : pool) t.join();
+	}
+
+	// 64-bit FNV-1a of everything that affects the result
+	uint64_t hash() const {
+		uint64_t h = 14695981039346656037ull;
+		auto add = [&](const void * data, size_t bytes){
+			auto c = (const unsigned char *)data;
+			for(size_t i=0; i<bytes; ++i) h = (h ^ c[i]) * 1099511628211ull;
+		};
+		const int format = 2; // bump when the baking itself changes
+		add(&format, sizeof format);
+		for(auto& s : mSurfaces){
+			add(s.name.data(), s.name.size());
+			add(&s.size, sizeof s.size);
+			add(&s.facing, sizeof s.facing);
+			add(&s.projection, sizeof s.projection);
+			add(s.positions.data(), s.positions.size() * sizeof(glm::vec3));
+			add(s.normals.data(), s.normals.size() * sizeof(glm::vec3));
+		}
+		add(mLights.data(), mLights.size() * sizeof(lighting::Light));
+		if(mRays){
+			add(&mRays, sizeof mRays);
+			add(&mRadius, sizeof mRadius);
+			add(&mVoxelRes, sizeof mVoxelRes);
+			add(mOccluders.data(), mOccluders.size() * sizeof(glm::vec3));
+		}
+		return h;
+	}
+
+	static bool load(Surface& s, const std::string& path){
+		if(!ofFile::doesFileExist(path, false)) return false;
+		return ofLoadImage(s.pixels, path) && s.pixels.getWidth() == size_t(s.size) && s.pixels.getHeight() == size_t(s.size)
+			&& s.pixels.getNumChannels() == 3;
+	}
+
+	// Delete earlier bakes of a surface
+	static void removeStale(const std::string& dir, const std::string& name, const std::string& keepFile){
+		ofDirectory d(dir);
+		d.allowExt("png");
+		d.listDir();
+		auto prefix = name + "-";
+		for(size_t i=0; i<d.size(); ++i){
+			auto file = d.getName(i);
+			if(file.compare(0, prefix.size(), prefix) == 0 && file != keepFile) ofFile::removeFile(d.getPath(i), false);
+		}
+	}
+
+	Voxels voxelise() const {
+		Voxels v;
+		if(!mRays || mOccluders.empty()) return v;
+		v.lo = glm::vec3(std::numeric_limits<float>::max());
+		v.hi = -v.lo;
+		for(auto& p : mOccluders){
+			v.lo = glm::min(v.lo, p);
+			v.hi = glm::max(v.hi, p);
+		}
+		auto ext = v.hi - v.lo;
+		v.cell = std::max(std::max(ext.x, ext.y), std::max(ext.z, 1e-6f)) / mVoxelRes;
+		v.lo -= v.cell;
+		v.hi += v.cell;
+		v.dim = glm::ivec3(glm::ceil((v.hi - v.lo) / v.cell));
+		v.solid.assign(size_t(v.dim.x) * v.dim.y * v.dim.z, 0);
+
+		// Mark cells under a grid of points on each triangle, spaced under half a cell
+		auto mark = [&](const glm::vec3& p){
+			auto c = glm::clamp(glm::ivec3(glm::floor((p - v.lo) / v.cell)), glm::ivec3(0), v.dim - 1);
+			v.solid[(size_t(c.z) * v.dim.y + c.y) * v.dim.x + c.x] = 1;
+		};
+		for(size_t t=0; t+2<mOccluders.size(); t+=3){
+			auto& a = mOccluders[t];
+			auto ab = mOccluders[t+1] - a, ac = mOccluders[t+2] - a;
+			float edge = std::max(glm::length(ab), std::max(glm::length(ac), glm::length(ac - ab)));
+			int n = std::max(1, int(std::ceil(edge / (v.cell * 0.5f))));
+			for(int i=0; i<=n; ++i)
+				for(int j=0; i+j<=n; ++j)
+					mark(a + ab * (float(i) / n) + ac * (float(j) / n));
+		}
+		return v;
+	}
+
+	// Fraction of cosine-weighted rays from p that escape the occluders within the radius
+	float openness(const Voxels& v, const glm::vec3& p, const glm::vec3& n, uint32_t seed) const {
+		if(v.empty()) return 1.f;
+		// Skip points too far from the grid to be occluded
+		auto q = glm::clamp(p, v.lo, v.hi);
+		if(glm::dot(q - p, q - p) > mRadius * mRadius) return 1.f;
+
+		auto t = glm::normalize(glm::cross(n, std::abs(n.x) < 0.9f ? glm::vec3(1., 0., 0.) : glm::vec3(0., 1., 0.)));
+		auto b = glm::cross(n, t);
+		// Golden-angle spiral over the disk, rotated per texel to trade banding for noise
+		seed = seed * 747796405u + 2891336453u;
+		float rot = float(seed >> 8) * (6.2831853f / 16777216.f);
+		float step = v.cell * 0.75f;
+		int open = 0;
+		for(int r=0; r<mRays; ++r){
+			float u = (r + 0.5f) / mRays;
+			float phi = r * 2.3999632f + rot;
+			float sr = std::sqrt(u);
+			auto dir = t * (sr * std::cos(phi)) + b * (sr * std::sin(phi)) + n * std::sqrt(1.f - u);
+			bool hit = false;
+			for(float s=1.5f*v.cell; s<mRadius && !hit; s+=step) hit = v.at(p + dir * s);
+			open += !hit;
+		}
+		return float(open) / mRays;
+	}
+
+	// Bake one surface into its pixels
+	/// @return number of texels covered
+	size_t bake(Surface& s, const Voxels& voxels) const {
+		int N = s.size;
+		auto front = glm::normalize(glm::vec3(s.projection[0][2], s.projection[1][2], s.projection[2][2]));
+
+		// Rasterise triangles at texel centres, keeping the frontmost
+		std::vector<float> depth(size_t(N) * N, -std::numeric_limits<float>::max());
+		std::vector<int> tri(depth.size(), -1);
+		std::vector<glm::vec3> bary(depth.size());
+		for(size_t t=0; t+2<s.positions.size(); t+=3){
+			if(s.facing){
+				auto n = s.worldNormals[t] + s.worldNormals[t+1] + s.worldNormals[t+2];
+				if(glm::dot(n, front) < minFacing * glm::length(n) || glm::dot(n, n) < 1e-12f) continue;
+			}
+			glm::vec3 q[3];
+			for(int k=0; k<3; ++k){
+				q[k] = glm::vec3(s.projection * glm::vec4(s.positions[t+k], 1.f));
+				q[k].x = q[k].x * N - 0.5f; // texel centres at integers
+				q[k].y = q[k].y * N - 0.5f;
+			}
+			float area = (q[1].x - q[0].x) * (q[2].y - q[0].y) - (q[2].x - q[0].x) * (q[1].y - q[0].y);
+			if(std::abs(area) < 1e-12f) continue;
+			int x0 = std::max(0, int(std::ceil(std::min(q[0].x, std::min(q[1].x, q[2].x)))));
+			int x1 = std::min(N-1, int(std::floor(std::max(q[0].x, std::max(q[1].x, q[2].x)))));
+			int y0 = std::max(0, int(std::ceil(std::min(q[0].y, std::min(q[1].y, q[2].y)))));
+			int y1 = std::min(N-1, int(std::floor(std::max(q[0].y, std::max(q[1].y, q[2].y)))));
+			for(int y=y0; y<=y1; ++y){
+				for(int x=x0; x<=x1; ++x){
+					float w0 = ((q[1].x - x) * (q[2].y - y) - (q[2].x - x) * (q[1].y - y)) / area;
+					float w1 = ((q[2].x - x) * (q[0].y - y) - (q[0].x - x) * (q[2].y - y)) / area;
+					float w2 = 1.f - w0 - w1;
+					const float eps = -1e-5f;
+					if(w0 < eps || w1 < eps || w2 < eps) continue;
+					float z = w0 * q[0].z + w1 * q[1].z + w2 * q[2].z;
+					size_t k = size_t(y) * N + x;
+					if(z <= depth[k]) continue;
+					depth[k] = z;
+					tri[k] = int(t);
+					bary[k] = glm::vec3(w0, w1, w2);
+				}
+			}
+		}
+
+		// Covered texels as surface points, plus the geometric normal facing front for occlusion
+		std::vector<size_t> texels;
+		for(size_t k=0; k<tri.size(); ++k) if(tri[k] >= 0) texels.push_back(k);
+		size_t n = texels.size();
+		lighting::SurfacePoints pts;
+		pts.resize(n);
+		std::vector<glm::vec3> facing(n);
+		for(size_t i=0; i<n; ++i){
+			size_t k = texels[i];
+			int t = tri[k];
+			auto w = bary[k];
+			auto& P = s.positions;
+			auto p = P[t] * w.x + P[t+1] * w.y + P[t+2] * w.z;
+			auto nrm = s.normals[t] * w.x + s.normals[t+1] * w.y + s.normals[t+2] * w.z;
+			nrm /= std::max(glm::length(nrm), 1e-12f);
+			auto g = glm::cross(P[t+1] - P[t], P[t+2] - P[t]);
+			g /= std::max(glm::length(g), 1e-12f);
+			facing[i] = glm::dot(g, front) < 0.f ? -g : g;
+			pts.px[i] = p.x; pts.py[i] = p.y; pts.pz[i] = p.z;
+			pts.nx[i] = nrm.x; pts.ny[i] = nrm.y; pts.nz[i] = nrm.z;
+		}
+
+		// Occlusion and lighting, in batches on all cores
+		std::vector<float> r(n, 0.f), g(n, 0.f), b(n, 0.f);
+		parallelFor(n, 256, [&](size_t begin, size_t end){
+			for(size_t i=begin; i<end; ++i){
+				glm::vec3 p(pts.px[i], pts.py[i], pts.pz[i]);
+				pts.ambient[i] = openness(voxels, p, facing[i], uint32_t(texels[i]));
+			}
+			for(auto& lt : mLights) lighting::addDiffuseFall(pts, begin, end, lt, r.data(), g.data(), b.data());
+		});
+
+		// Write texels, then grow them into uncovered neighbours so filtering does not pull in black
+		std::vector<float> img(size_t(N) * N * 3, 0.f);
+		std::vector<uint8_t> filled(size_t(N) * N, 0);
+		for(size_t i=0; i<n; ++i){
+			size_t k = texels[i];
+			img[k*3] = r[i];
+			img[k*3+1] = g[i];
+			img[k*3+2] = b[i];
+			filled[k] = 1;
+		}
+		for(int pass=0; pass<2; ++pass){
+			auto prev = filled;
+			for(int y=0; y<N; ++y){
+				for(int x=0; x<N; ++x){
+					size_t k = size_t(y) * N + x;
+					if(prev[k]) continue;
+					float sum[3] = {0.f, 0.f, 0.f};
+					int cnt = 0;
+					for(auto o : {glm::ivec2(-1, 0), glm::ivec2(1, 0), glm::ivec2(0, -1), glm::ivec2(0, 1)}){
+						int xx = x + o.x, yy = y + o.y;
+						if(xx < 0 || yy < 0 || xx >= N || yy >= N) continue;
+						size_t j = size_t(yy) * N + xx;
+						if(!prev[j]) continue;
+						for(int c=0; c<3; ++c) sum[c] += img[j*3+c];
+						++cnt;
+					}
+					if(!cnt) continue;
+					for(int c=0; c<3; ++c) img[k*3+c] = sum[c] / cnt;
+					filled[k] = 1;
+				}
+			}
+		}
+
+		s.pixels.allocate(N, N, OF_PIXELS_RGB);
+		for(size_t k=0; k<img.size(); ++k)
+			s.pixels[k] = uint16_t(std::min(std::max(img[k] / range, 0.f), 1.f) * 65535.f + 0.5f);
+		return n;
+	}
+
+	std::vector<Surface> mSurfaces;
+	std::vector<glm::vec3> mOccluders;	// world space, three per triangle
+	std::vector<lighting::Light> mLights;
+	int mRays = 0;
+	float mRadius = 0.25f;
+	int mVoxelRes = 128;
+};
+
+#endif // include guard
@@ -0,0 +1,87 @@
+#ifndef INC_MAPPEDFILE_H
+#define INC_MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+// Read-only memory-mapped file
+
+// The file's pages are mapped straight into the address space, so data can be
+// used in place without being read or parsed. The mapping is page aligned.
+class MappedFile{
+public:
+
+	MappedFile(){}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile(){ close(); }
+
+	// Map a file (absolute path); returns false if it cannot be opened
+	bool open(const std::string& path){
+		close();
+		#ifdef _WIN32
+		mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if(mFile == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER size;
+		if(GetFileSizeEx(mFile, &size) && size.QuadPart > 0){
+			mMap = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if(mMap) mData = MapViewOfFile(mMap, FILE_MAP_READ, 0, 0, 0);
+			mSize = std::size_t(size.QuadPart);
+		}
+		#else
+		mFile = ::open(path.c_str(), O_RDONLY);
+		if(mFile < 0) return false;
+		struct stat st;
+		if(fstat(mFile, &st) == 0 && st.st_size > 0){
+			void * p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, mFile, 0);
+			if(p != MAP_FAILED) mData = p;
+			mSize = std::size_t(st.st_size);
+		}
+		#endif
+		if(!mData) close();
+		return mData != nullptr;
+	}
+
+	// Unmap file
+	void close(){
+		#ifdef _WIN32
+		if(mData) UnmapViewOfFile(mData);
+		if(mMap) CloseHandle(mMap);
+		if(mFile != INVALID_HANDLE_VALUE) CloseHandle(mFile);
+		mMap = nullptr;
+		mFile = INVALID_HANDLE_VALUE;
+		#else
+		if(mData) munmap(mData, mSize);
+		if(mFile >= 0) ::close(mFile);
+		mFile = -1;
+		#endif
+		mData = nullptr;
+		mSize = 0;
+	}
+
+	const void * data() const { return mData; }
+	std::size_t size() const { return mSize; }
+
+private:
+	void * mData = nullptr;
+	std::size_t mSize = 0;
+	#ifdef _WIN32
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	HANDLE mMap = nullptr;
+	#else
+	int mFile = -1;
+	#endif
+};
+
+#endif // include guard
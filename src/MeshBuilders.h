@@ -0,0 +1,51 @@
+#ifndef INC_MESHBUILDERS_H
+#define INC_MESHBUILDERS_H
+
+#include "ofMesh.h"
+
+// Helpers that append simple shapes to a mesh
+
+//Adds a rectangle lying on the xy plane centered around the given position
+inline void addRect(ofFloatColor col, ofMesh& m, glm::vec3 pos, float w = 2.f, float h = 2.f) {
+	using glm::vec3;
+	float w_2 = w * 0.5;
+	float h_2 = h * 0.5;
+	int Nv = m.getVertices().size();
+	m.setMode(OF_PRIMITIVE_TRIANGLES);
+	m.addVertex(pos + vec3(-w_2, -h_2, 0.));
+	m.addVertex(pos + vec3(w_2, -h_2, 0.));
+	m.addVertex(pos + vec3(w_2, h_2, 0.));
+	m.addVertex(pos + vec3(-w_2, h_2, 0.));
+	m.addTriangle(Nv + 0, Nv + 1, Nv + 2);
+	m.addTriangle(Nv + 0, Nv + 2, Nv + 3);
+
+	//Adds colour to vertices
+	for (auto& p : m.getVertices()) m.addColor(col);
+}
+
+//Adds a custom quad mesh with texture co-ordinates and normals
+inline void addQuad(ofMesh& m, glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 d, ofFloatColor col)
+{
+	using glm::vec2;
+	//Creates vertex's of quad
+	m.addVertex(a);
+	m.addVertex(b);
+	m.addVertex(c);
+	m.addVertex(d);
+
+	//Adds texture co-ords
+	m.addTexCoord(vec2(0, 0));
+	m.addTexCoord(vec2(1, 0));
+	m.addTexCoord(vec2(1, 1));
+	m.addTexCoord(vec2(0, 1));
+
+	//Triangles
+	m.addTriangle(0, 1, 2);
+	m.addTriangle(0, 2, 3);
+
+	//Colour + Normals
+	for (auto& p : m.getVertices()) m.addNormal(normalize(-p));
+	for (auto& p : m.getVertices()) m.addColor(col);
+}
+
+#endif // include guard
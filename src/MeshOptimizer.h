@@ -0,0 +1,332 @@
+#ifndef INC_MESHOPTIMIZER_H
+#define INC_MESHOPTIMIZER_H
+
+#include <algorithm> // min, max, fill
+#include <cmath> // pow, sqrt, round
+#include <cstddef> // offsetof
+#include <cstdio> // snprintf
+#include <cstdint>
+#include <cstring> // memcmp
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ofGLUtils.h" // GL headers
+#include "ofMesh.h"
+#include "ofxAssimpModelLoader.h"
+
+/*
+Import-time optimisation of model meshes.
+
+Each mesh is quantised into a 16-byte vertex:
+	position	3 x 16-bit snorm over the mesh bounds
+	normal		10:10:10:2 snorm
+	texcoord	2 x 16-bit unorm (clamped to [0,1]; textures clamp to edge anyway)
+Position dequantisation is an affine map, so it is folded into the mesh's
+matrix and done by the vertex shader's model transform for free. Identical
+quantised vertices are merged, triangles are reordered for the post-transform
+vertex cache (Forsyth's linear-speed algorithm) and vertices renumbered in
+first-use order for fetch locality.
+*/
+
+namespace meshopt{
+
+// Simulated FIFO post-transform cache size used for statistics
+static const int fifoSize = 16;
+
+// Average vertex shader invocations per triangle (ACMR) with a FIFO cache
+static float acmr(const std::vector<uint32_t>& indices, size_t numVerts, int cacheSize = fifoSize){
+	if(indices.empty()) return 0.f;
+	std::vector<uint32_t> stamp(numVerts, 0);
+	uint32_t time = cacheSize + 1, misses = 0;
+	for(auto v : indices){
+		if(time - stamp[v] > uint32_t(cacheSize)){
+			stamp[v] = time++;
+			++misses;
+		}
+	}
+	return float(misses) / (indices.size() / 3);
+}
+
+// Reorder triangles for post-transform cache reuse (Tom Forsyth, 2006)
+static std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t>& indices, size_t numVerts){
+	const int cacheSize = 32;
+	size_t numTris = indices.size() / 3;
+
+	// Vertex to triangle adjacency; live counts shrink as triangles are emitted
+	std::vector<uint32_t> live(numVerts, 0), offset(numVerts + 1, 0), adj(indices.size());
+	for(auto v : indices) ++live[v];
+	for(size_t v=0; v<numVerts; ++v) offset[v+1] = offset[v] + live[v];
+	{
+		std::vector<uint32_t> fill(offset.begin(), offset.end()-1);
+		for(size_t i=0; i<indices.size(); ++i) adj[fill[indices[i]]++] = uint32_t(i / 3);
+	}
+
+	std::vector<int> cachePos(numVerts, -1);
+	auto vertexScore = [&](uint32_t v){
+		if(!live[v]) return -1.f;
+		float s = 0.f;
+		int p = cachePos[v];
+		if(p >= 0) s = p < 3 ? 0.75f : std::pow(1.f - (p - 3) * (1.f / (cacheSize - 3)), 1.5f);
+		return s + 2.f / std::sqrt(float(live[v]));
+	};
+
+	std::vector<float> vScore(numVerts), tScore(numTris, 0.f);
+	std::vector<char> emitted(numTris, 0);
+	for(size_t v=0; v<numVerts; ++v) vScore[v] = vertexScore(uint32_t(v));
+	for(size_t t=0; t<numTris; ++t) for(int k=0; k<3; ++k) tScore[t] += vScore[indices[3*t+k]];
+
+	std::vector<uint32_t> out, cache, next;
+	out.reserve(indices.size());
+	size_t cursor = 0;
+	long best = -1;
+	while(out.size() < indices.size()){
+		if(best < 0){ // nothing in cache to continue from
+			while(emitted[cursor]) ++cursor;
+			best = long(cursor);
+		}
+		auto tri = &indices[3*best];
+		emitted[best] = 1;
+		for(int k=0; k<3; ++k){
+			auto v = tri[k];
+			out.push_back(v);
+			auto b = adj.begin() + offset[v], e = b + live[v];
+			auto it = std::find(b, e, uint32_t(best));
+			std::iter_swap(it, e-1);
+			--live[v];
+		}
+
+		// Emitted vertices move to the front of the LRU cache
+		next.assign(tri, tri+3);
+		for(auto v : cache) if(v != tri[0] && v != tri[1] && v != tri[2]) next.push_back(v);
+		for(size_t i=0; i<next.size(); ++i) cachePos[next[i]] = i < size_t(cacheSize) ? int(i) : -1;
+
+		// Rescore touched vertices and pick the best triangle using them
+		float bestScore = -1.f;
+		best = -1;
+		for(auto v : next){
+			float d = vertexScore(v) - vScore[v];
+			vScore[v] += d;
+			for(auto t = offset[v]; t < offset[v] + live[v]; ++t) tScore[adj[t]] += d;
+		}
+		for(size_t i=0; i<next.size() && i<size_t(cacheSize); ++i){
+			auto v = next[i];
+			for(auto t = offset[v]; t < offset[v] + live[v]; ++t){
+				if(tScore[adj[t]] > bestScore){ bestScore = tScore[adj[t]]; best = long(adj[t]); }
+			}
+		}
+		if(next.size() > size_t(cacheSize)) next.resize(cacheSize);
+		cache.swap(next);
+	}
+	return out;
+}
+
+// Packed vertex; see top of file
+struct PackedVertex{
+	int16_t pos[4];
+	uint32_t normal;
+	uint16_t uv[2];
+};
+
+static int16_t snorm16(float v){ return int16_t(std::round(std::min(std::max(v, -1.f), 1.f) * 32767.f)); }
+static uint16_t unorm16(float v){ return uint16_t(std::round(std::min(std::max(v, 0.f), 1.f) * 65535.f)); }
+static uint32_t snorm10(float v){ return uint32_t(int(std::round(std::min(std::max(v, -1.f), 1.f) * 511.f))) & 0x3FF; }
+static uint32_t pack1010102(const glm::vec3& n){ return snorm10(n.x) | (snorm10(n.y) << 10) | (snorm10(n.z) << 20); }
+
+} // meshopt::
+
+// Optimised GPU copy of a model's meshes
+class OptimizedModel{
+public:
+
+	struct Stats{
+		size_t vertsBefore = 0, vertsAfter = 0;
+		size_t bytesBefore = 0, bytesAfter = 0;	// vertex + index buffers
+		float acmrBefore = 0.f, acmrAfter = 0.f;	// vertex shader invocations per triangle
+		size_t tris = 0;
+	};
+
+	OptimizedModel(){}
+	OptimizedModel(const OptimizedModel&) = delete;
+	OptimizedModel& operator=(const OptimizedModel&) = delete;
+	~OptimizedModel(){ clear(); }
+
+	// Whether the GL context can read 10:10:10:2 normals
+	static bool supported(){
+		#ifndef TARGET_OPENGLES
+		return GLEW_VERSION_3_3 || GLEW_ARB_vertex_type_2_10_10_10_rev;
+		#else
+		return false;
+		#endif
+	}
+
+	// Build from a loaded model
+
+	/// @param[in] model		Loaded model
+	/// @param[in] freeSource	Free the model's own vertex buffers once copied
+	bool setup(ofxAssimpModelLoader& model, bool freeSource = true){
+		clear();
+		if(!supported()) return false;
+		mModelMatrix = model.getModelMatrix();
+		for(unsigned i=0; i<model.getMeshCount(); ++i){
+			auto& helper = model.getMeshHelper(i);
+			// Only free what has been copied, so a skipped mesh keeps its own buffers
+			if(addPart(model.getMesh(i), helper.matrix) && freeSource) helper.vbo.clear();
+		}
+		if(mStats.tris){
+			mStats.acmrBefore /= mStats.tris;
+			mStats.acmrAfter /= mStats.tris;
+		}
+		return true;
+	}
+
+	// Draw one mesh, each instanced n times, leaving its transform to the caller
+	void drawPart(size_t i, int instances = 1) const {
+		auto& p = mParts[i];
+		glBindVertexArray(p.vao);
+		glDrawElementsInstanced(GL_TRIANGLES, p.count, p.indexType, nullptr, instances);
+		glBindVertexArray(0);
+	}
+
+	// GPU buffers of one mesh, in the PackedVertex layout
+	struct Part{
+		glm::mat4 matrix;	// mesh transform and position dequantisation
+		GLuint vao = 0, vbo = 0, ibo = 0;
+		GLsizei count = 0;	// indices
+		GLsizei verts = 0;
+		GLenum indexType = GL_UNSIGNED_INT;
+	};
+
+	const std::vector<Part>& parts() const { return mParts; }
+	const glm::mat4& modelMatrix() const { return mModelMatrix; }
+
+	bool empty() const { return mParts.empty(); }
+	const Stats& stats() const { return mStats; }
+
+	// Get one-line summary of the optimisation
+	std::string report() const {
+		auto& s = mStats;
+		char buf[160];
+		snprintf(buf, sizeof buf, "%zu -> %zu verts, ACMR %.2f -> %.2f (%.0f%%), %.1f -> %.1f KiB",
+			s.vertsBefore, s.vertsAfter, s.acmrBefore, s.acmrAfter,
+			s.acmrBefore > 0.f ? 100.f * s.acmrAfter / s.acmrBefore : 0.f,
+			s.bytesBefore / 1024.f, s.bytesAfter / 1024.f);
+		return buf;
+	}
+
+	void clear(){
+		for(auto& p : mParts){
+			glDeleteVertexArrays(1, &p.vao);
+			glDeleteBuffers(1, &p.vbo);
+			glDeleteBuffers(1, &p.ibo);
+		}
+		mParts.clear();
+		mStats = Stats();
+	}
+
+private:
+	// Add a mesh as a part; false if it has no vertices
+	bool addPart(const ofMesh& mesh, const glm::mat4& meshMatrix){
+		using namespace meshopt;
+		auto& P = mesh.getVertices();
+		auto& N = mesh.getNormals();
+		auto& T = mesh.getTexCoords();
+		bool hasN = N.size() == P.size(), hasT = T.size() == P.size();
+		if(P.empty()) return false;
+
+		std::vector<uint32_t> indices(mesh.getIndices().begin(), mesh.getIndices().end());
+		if(indices.empty()) for(uint32_t i=0; i<P.size(); ++i) indices.push_back(i);
+		indices.resize(indices.size() / 3 * 3);
+
+		mStats.vertsBefore += P.size();
+		mStats.bytesBefore += P.size() * (sizeof(glm::vec3) + (hasN ? sizeof(glm::vec3) : 0) + (hasT ? sizeof(glm::vec2) : 0)
+			+ (mesh.hasColors() ? sizeof(ofFloatColor) : 0)) + indices.size() * sizeof(ofIndexType);
+		mStats.acmrBefore += acmr(indices, P.size()) * (indices.size() / 3);
+
+		// Quantise over bounds; q in [-1,1] maps to centre + q * half
+		glm::vec3 lo = P[0], hi = P[0];
+		for(auto& p : P){ lo = glm::min(lo, p); hi = glm::max(hi, p); }
+		auto centre = (lo + hi) * 0.5f, half = (hi - lo) * 0.5f;
+		auto inv = glm::vec3(
+			half.x > 0.f ? 1.f/half.x : 0.f, half.y > 0.f ? 1.f/half.y : 0.f, half.z > 0.f ? 1.f/half.z : 0.f);
+
+		// Quantise and merge identical vertices
+		std::vector<PackedVertex> verts;
+		std::vector<uint32_t> remap(P.size());
+		std::unordered_map<std::string, uint32_t> unique;
+		for(size_t i=0; i<P.size(); ++i){
+			PackedVertex v{};
+			auto q = (P[i] - centre) * inv;
+			v.pos[0] = snorm16(q.x); v.pos[1] = snorm16(q.y); v.pos[2] = snorm16(q.z);
+			if(hasN){
+				// Degenerate (zero or NaN) normals would normalise to NaN; point them along z
+				float nn = glm::dot(N[i], N[i]);
+				v.normal = pack1010102(nn > 1e-12f ? N[i] / std::sqrt(nn) : glm::vec3(0.f, 0.f, 1.f));
+			}
+			if(hasT){ v.uv[0] = unorm16(T[i].x); v.uv[1] = unorm16(T[i].y); }
+			auto key = std::string((const char *)&v, sizeof v);
+			auto it = unique.emplace(key, uint32_t(verts.size()));
+			if(it.second) verts.push_back(v);
+			remap[i] = it.first->second;
+		}
+		for(auto& i : indices) i = remap[i];
+
+		// Cache order, then renumber vertices in first-use order
+		indices = optimizeVertexCache(indices, verts.size());
+		std::vector<uint32_t> order(verts.size(), ~0u);
+		std::vector<PackedVertex> fetched;
+		fetched.reserve(verts.size());
+		for(auto& i : indices){
+			if(order[i] == ~0u){ order[i] = uint32_t(fetched.size()); fetched.push_back(verts[i]); }
+			i = order[i];
+		}
+
+		mStats.vertsAfter += fetched.size();
+		mStats.acmrAfter += acmr(indices, fetched.size()) * (indices.size() / 3);
+		mStats.tris += indices.size() / 3;
+
+		// Upload
+		Part part;
+		part.matrix = meshMatrix * glm::translate(glm::mat4(1.f), centre) * glm::scale(glm::mat4(1.f), half);
+		part.count = GLsizei(indices.size());
+		part.verts = GLsizei(fetched.size());
+		bool shortIndex = fetched.size() <= 0xFFFF;
+		part.indexType = shortIndex ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+		glGenVertexArrays(1, &part.vao);
+		glBindVertexArray(part.vao);
+		glGenBuffers(1, &part.vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, part.vbo);
+		glBufferData(GL_ARRAY_BUFFER, fetched.size() * sizeof(PackedVertex), fetched.data(), GL_STATIC_DRAW);
+		glGenBuffers(1, &part.ibo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, part.ibo);
+		if(shortIndex){
+			std::vector<uint16_t> idx16(indices.begin(), indices.end());
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx16.size() * 2, idx16.data(), GL_STATIC_DRAW);
+		} else {
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * 4, indices.data(), GL_STATIC_DRAW);
+		}
+		mStats.bytesAfter += fetched.size() * sizeof(PackedVertex) + indices.size() * (shortIndex ? 2 : 4);
+
+		auto stride = GLsizei(sizeof(PackedVertex));
+		glEnableVertexAttribArray(ofShader::POSITION_ATTRIBUTE);
+		glVertexAttribPointer(ofShader::POSITION_ATTRIBUTE, 3, GL_SHORT, GL_TRUE, stride, (void *)offsetof(PackedVertex, pos));
+		if(hasN){
+			glEnableVertexAttribArray(ofShader::NORMAL_ATTRIBUTE);
+			glVertexAttribPointer(ofShader::NORMAL_ATTRIBUTE, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void *)offsetof(PackedVertex, normal));
+		}
+		if(hasT){
+			glEnableVertexAttribArray(ofShader::TEXCOORD_ATTRIBUTE);
+			glVertexAttribPointer(ofShader::TEXCOORD_ATTRIBUTE, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void *)offsetof(PackedVertex, uv));
+		}
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		mParts.push_back(part);
+		return true;
+	}
+
+	std::vector<Part> mParts;
+	glm::mat4 mModelMatrix;
+	Stats mStats;
+};
+
+#endif // include guard
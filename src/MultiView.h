@@ -0,0 +1,159 @@
+#ifndef INC_MULTIVIEW_H
+#define INC_MULTIVIEW_H
+
+#include <algorithm> // min, max
+#include <cmath>
+#include <string>
+#include <vector>
+#include "ofShader.h"
+#include "ofVectorMath.h"
+#include "glm/gtc/constants.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+// Multi-view rendering into tiles of one render target
+
+// Every draw is instanced once per view. The vertex shader picks the view from
+// gl_InstanceID, transforms by that view's camera and squeezes the result into
+// the view's tile, clipping to the tile edges with gl_ClipDistance. CPU work
+// (culling, transforms, material and state changes) is done once for all views.
+class MultiView{
+public:
+	static const int maxViews = 16;
+
+	// Set views from camera view matrices sharing one projection
+
+	/// @param[in] viewMats		View (world to eye) matrix of each camera
+	/// @param[in] projection	Projection matrix; aspect should match a tile
+	/// @param[in] cols			Number of tile columns; rows follow from the view count
+	/// @param[in] flipY		Flip vertically, as openFrameworks does for FBO targets
+	MultiView& set(const std::vector<glm::mat4>& viewMats, const glm::mat4& projection, int cols, bool flipY = true){
+		int n = std::min(int(viewMats.size()), maxViews);
+		mCols = std::max(cols, 1);
+		mRows = (n + mCols - 1) / mCols;
+		auto flip = glm::scale(glm::mat4(1.f), glm::vec3(1.f, flipY ? -1.f : 1.f, 1.f));
+		mViewProjections.resize(n);
+		mCameras.resize(n);
+		mEyes.resize(n);
+		mTiles.resize(n);
+		for(int i=0; i<n; ++i){
+			mViewProjections[i] = flip * projection * viewMats[i];
+			mCameras[i] = glm::inverse(viewMats[i]);
+			mEyes[i] = glm::vec3(mCameras[i][3]);
+			int c = i % mCols, r = i / mCols;
+			// With the flip, the top row of the image is at the bottom in NDC
+			float y = flipY ? -1.f + (2*r+1.f)/mRows : 1.f - (2*r+1.f)/mRows;
+			mTiles[i] = glm::vec4(-1.f + (2*c+1.f)/mCols, y, 1.f/mCols, 1.f/mRows);
+		}
+		return *this;
+	}
+
+	// Clear views to go back to single-view rendering
+	MultiView& clear(){ mViewProjections.clear(); return *this; }
+
+	// Get number of views (0 when rendering a single view normally)
+	int size() const { return int(mViewProjections.size()); }
+	// Get number of instances each draw needs
+	int instances() const { return std::max(size(), 1); }
+	int cols() const { return mCols; }
+	int rows() const { return mRows; }
+
+	// Get names of the uniforms declared by the GLSL below, in the order apply() expects
+	static std::vector<std::string> uniformNames(){
+		return {"numViews", "viewProjections", "viewCameras", "viewEyes", "viewTiles"};
+	}
+
+	// Upload views to a shader built with the GLSL below; call after begin()
+
+	/// @param[in] locations	Locations of uniformNames(), resolved when the shader linked
+	void apply(const GLint * locations) const {
+		int n = size();
+		if(!n) return;
+		glUniform1i(locations[0], n);
+		glUniformMatrix4fv(locations[1], n, GL_FALSE, &mViewProjections[0][0][0]);
+		glUniformMatrix4fv(locations[2], n, GL_FALSE, &mCameras[0][0][0]);
+		glUniform3fv(locations[3], n, &mEyes[0].x);
+		glUniform4fv(locations[4], n, &mTiles[0].x);
+	}
+
+	// Enable/disable the clip planes bounding each tile
+	static void enableClipping(bool v){
+		for(int i=0; i<4; ++i){
+			if(v) glEnable(GL_CLIP_DISTANCE0+i);
+			else glDisable(GL_CLIP_DISTANCE0+i);
+		}
+	}
+
+	// Turntable view matrices orbiting a target
+	static std::vector<glm::mat4> orbit(int n, const glm::vec3& target, float radius, float height){
+		std::vector<glm::mat4> views;
+		for(int i=0; i<n; ++i){
+			float a = glm::two_pi<float>() * i / n;
+			auto eye = target + glm::vec3(radius*std::sin(a), height, radius*std::cos(a));
+			views.push_back(glm::lookAt(eye, target, glm::vec3(0,1,0)));
+		}
+		return views;
+	}
+
+	// Vertex program declarations
+
+	// viewClip(clip, world) returns the single-view clip position or, when
+	// MULTIVIEW is defined, the world position seen from this instance's view
+	// and placed in its tile. viewCamera(m) does the same for a camera matrix.
+	static std::string glslVertex(){
+		return R"(
+		#ifdef MULTIVIEW
+		uniform int numViews;
+		uniform mat4 viewProjections[16];
+		uniform mat4 viewCameras[16];
+		uniform vec4 viewTiles[16]; // NDC centre (xy) and half size (zw)
+
+		out float gl_ClipDistance[4];
+		flat out int vview;
+
+		mat4 viewCamera ( mat4 single )
+			{
+				return viewCameras[ gl_InstanceID % numViews ];
+			}
+
+		vec4 viewClip ( vec4 single , vec4 world )
+			{
+				vview = gl_InstanceID % numViews;
+				vec4 clip = viewProjections[ vview ] * world;
+				// clip to this view's own frustum, which becomes the tile edges
+				gl_ClipDistance[0] = clip.w + clip.x;
+				gl_ClipDistance[1] = clip.w - clip.x;
+				gl_ClipDistance[2] = clip.w + clip.y;
+				gl_ClipDistance[3] = clip.w - clip.y;
+				clip.xy = clip.xy * viewTiles[ vview ].zw + viewTiles[ vview ].xy * clip.w;
+				return clip;
+			}
+		#else
+		mat4 viewCamera ( mat4 single ) { return single; }
+		vec4 viewClip ( vec4 single , vec4 world ) { return single; }
+		#endif
+		)";
+	}
+
+	// Fragment program declarations; viewEye(eye) gives the eye of this view
+	static std::string glslFragment(){
+		return R"(
+		#ifdef MULTIVIEW
+		uniform vec3 viewEyes[16];
+		flat in int vview;
+
+		vec3 viewEye ( vec3 single ) { return viewEyes[ vview ]; }
+		#else
+		vec3 viewEye ( vec3 single ) { return single; }
+		#endif
+		)";
+	}
+
+private:
+	std::vector<glm::mat4> mViewProjections;
+	std::vector<glm::mat4> mCameras;
+	std::vector<glm::vec3> mEyes;
+	std::vector<glm::vec4> mTiles;
+	int mCols = 1, mRows = 1;
+};
+
+#endif // include guard
@@ -0,0 +1,34 @@
+#ifndef INC_NOISE_H
+#define INC_NOISE_H
+
+#include "ofMath.h" // ofNoise
+#include "ofPixels.h"
+
+// Fill a gray image with fractal (fBm) Perlin noise
+
+/// @param[out] pix		Pixels to fill; must be allocated as OF_PIXELS_GRAY
+/// @param[in] octaves	Number of octaves summed, each at twice the frequency of the last
+/// @param[in] f0		Frequency of the first octave, in cycles across the image
+inline void fbmNoise(ofPixels& pix, int octaves = 6, float f0 = 2.f){
+	int W = pix.getWidth(), H = pix.getHeight();
+	for (int j = 0; j < H; ++j)
+	{
+		for (int i = 0; i < W; ++i)
+		{
+			auto uv = glm::vec2(i, j) / (glm::vec2(W, H) - 1.f);
+			float val = 0.;
+			float f = f0; // starting frequency
+			float Asum = 0.; // used to scale final amplitude into [0,1]
+			for (int k = 1; k <= octaves; ++k)
+			{
+				float A = 1. / f;
+				val += A * ofNoise(uv * f);
+				f *= 2.f;
+				Asum += A;
+			}
+			pix[j * W + i] = val / Asum * 255;
+		}
+	}
+}
+
+#endif // include guard
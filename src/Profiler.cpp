@@ -0,0 +1,189 @@
+#include "Profiler.h"
+#include <algorithm> // min
+#include <atomic>
+#include <cstdio> // snprintf
+#include <cstdlib> // malloc, free
+#include <cstring> // strcmp
+#include <new>
+
+namespace{
+
+const int maxDepth = 16;
+
+struct Slot{
+	const char * name = "";
+	uint64_t allocs = 0, bytes = 0;
+	double ms = 0.;
+};
+
+Slot slots[Profiler::maxScopes];
+Profiler::Stats last[Profiler::maxScopes];
+int numSlots = 1;
+
+std::atomic<bool> tracking{false};
+std::atomic<uint64_t> otherAllocs{0}, otherBytes{0};
+Profiler::Stats lastOther;
+
+// Open scopes of the frame thread; other threads never push
+thread_local int stack[maxDepth];
+thread_local int depth = 0;
+thread_local bool frameThread = false;
+
+int slotFor(const char * name){
+	for(int i=1; i<numSlots; ++i){
+		if(slots[i].name == name || !std::strcmp(slots[i].name, name)) return i;
+	}
+	if(numSlots == Profiler::maxScopes) return 0;
+	slots[numSlots].name = name;
+	return numSlots++;
+}
+
+} // ::
+
+Profiler::Scope::Scope(const char * name)
+:	mStart(std::chrono::steady_clock::now()), mSlot(slotFor(name))
+{
+	frameThread = true;
+	if(depth < maxDepth) stack[depth] = mSlot;
+	++depth;
+}
+
+Profiler::Scope::~Scope(){
+	--depth;
+	std::chrono::duration<double, std::milli> dt = std::chrono::steady_clock::now() - mStart;
+	slots[mSlot].ms += dt.count();
+}
+
+void Profiler::trackAllocations(bool v){ tracking = v; }
+bool Profiler::trackingAllocations(){ return tracking; }
+
+void Profiler::countAllocation(std::size_t bytes){
+	if(!tracking) return;
+	if(frameThread){
+		auto& s = slots[depth > 0 ? stack[std::min(depth, maxDepth)-1] : 0];
+		++s.allocs;
+		s.bytes += bytes;
+	} else {
+		++otherAllocs;
+		otherBytes += bytes;
+	}
+}
+
+void Profiler::endFrame(){
+	slots[0].name = "(unscoped)";
+	for(int i=0; i<numSlots; ++i){
+		auto& s = slots[i];
+		last[i].name = s.name;
+		last[i].allocs = s.allocs;
+		last[i].bytes = s.bytes;
+		last[i].ms = float(s.ms);
+		s.allocs = s.bytes = 0;
+		s.ms = 0.;
+	}
+	lastOther.name = "(other threads)";
+	lastOther.allocs = otherAllocs.exchange(0);
+	lastOther.bytes = otherBytes.exchange(0);
+}
+
+int Profiler::numScopes(){ return numSlots; }
+const Profiler::Stats& Profiler::scope(int i){ return last[i]; }
+
+Profiler::Stats Profiler::frame(){
+	Stats t;
+	t.name = "frame";
+	for(int i=0; i<numSlots; ++i){
+		t.allocs += last[i].allocs;
+		t.bytes += last[i].bytes;
+	}
+	return t;
+}
+
+Profiler::Stats Profiler::otherThreads(){ return lastOther; }
+
+std::string Profiler::report(){
+	std::string r;
+	char line[128];
+	auto add = [&](const Stats& s){
+		std::snprintf(line, sizeof line, "  %-16s %8.3f ms %6llu allocs %10llu bytes\n",
+			s.name, s.ms, (unsigned long long)s.allocs, (unsigned long long)s.bytes);
+		r += line;
+	};
+	add(frame());
+	for(int i=0; i<numSlots; ++i) add(last[i]);
+	add(lastOther);
+	return r;
+}
+
+
+// Global heap hooks; they only add a counter increment to the default behaviour
+
+void * operator new(std::size_t n){
+	Profiler::countAllocation(n);
+	if(void * p = std::malloc(n ? n : 1)) return p;
+	throw std::bad_alloc();
+}
+
+void * operator new[](std::size_t n){
+	return operator new(n);
+}
+
+void * operator new(std::size_t n, const std::nothrow_t&) noexcept {
+	Profiler::countAllocation(n);
+	return std::malloc(n ? n : 1);
+}
+
+void * operator new[](std::size_t n, const std::nothrow_t& t) noexcept {
+	return operator new(n, t);
+}
+
+void operator delete(void * p) noexcept { std::free(p); }
+void operator delete[](void * p) noexcept { std::free(p); }
+void operator delete(void * p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void * p, std::size_t) noexcept { std::free(p); }
+void operator delete(void * p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void * p, const std::nothrow_t&) noexcept { std::free(p); }
+
+#ifdef __cpp_aligned_new
+static void * alignedAlloc(std::size_t n, std::size_t a){
+	#ifdef _WIN32
+	return _aligned_malloc(n ? n : 1, a);
+	#else
+	void * p = nullptr;
+	return posix_memalign(&p, a < sizeof(void*) ? sizeof(void*) : a, n ? n : 1) ? nullptr : p;
+	#endif
+}
+
+static void alignedFree(void * p){
+	#ifdef _WIN32
+	_aligned_free(p);
+	#else
+	std::free(p);
+	#endif
+}
+
+void * operator new(std::size_t n, std::align_val_t a){
+	Profiler::countAllocation(n);
+	if(void * p = alignedAlloc(n, std::size_t(a))) return p;
+	throw std::bad_alloc();
+}
+
+void * operator new[](std::size_t n, std::align_val_t a){
+	return operator new(n, a);
+}
+
+void * operator new(std::size_t n, std::align_val_t a, const std::nothrow_t&) noexcept {
+	Profiler::countAllocation(n);
+	return alignedAlloc(n, std::size_t(a));
+}
+
+void * operator new[](std::size_t n, std::align_val_t a, const std::nothrow_t& t) noexcept {
+	return operator new(n, a, t);
+}
+
+void operator delete(void * p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void * p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete(void * p, std::size_t, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void * p, std::size_t, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete(void * p, std::align_val_t, const std::nothrow_t&) noexcept { alignedFree(p); }
+void operator delete[](void * p, std::align_val_t, const std::nothrow_t&) noexcept { alignedFree(p); }
+#endif
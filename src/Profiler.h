@@ -0,0 +1,61 @@
+#ifndef INC_PROFILER_H
+#define INC_PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Per-frame profiling scopes with heap allocation counts
+
+// A Scope attributes the time between its construction and destruction to a
+// name (inclusive of nested scopes). When allocation tracking is on, every
+// operator new made on the frame thread is counted against the innermost open
+// scope, or "(unscoped)" if none is open. Allocations on other threads are
+// counted separately. Nothing here allocates, so it can count itself out.
+class Profiler{
+public:
+	static const int maxScopes = 32;
+
+	struct Stats{
+		const char * name = "";
+		uint64_t allocs = 0;	// heap allocations
+		uint64_t bytes = 0;		// bytes requested
+		float ms = 0.f;			// wall time, inclusive
+	};
+
+	// Scope guard; name must be a string literal (it is kept by pointer)
+	class Scope{
+	public:
+		explicit Scope(const char * name);
+		~Scope();
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	private:
+		std::chrono::steady_clock::time_point mStart;
+		int mSlot;
+	};
+
+	// Turn allocation counting on or off
+	static void trackAllocations(bool v);
+	static bool trackingAllocations();
+
+	// Close the current frame; its numbers become the last frame's
+	static void endFrame();
+
+	// Get number of scopes seen so far
+	static int numScopes();
+	// Get last frame's stats of a scope; index 0 is "(unscoped)"
+	static const Stats& scope(int i);
+	// Get last frame's allocation totals on the frame thread
+	static Stats frame();
+	// Get last frame's allocations made on other threads
+	static Stats otherThreads();
+
+	// Get a multi-line report of the last frame
+	static std::string report();
+
+	// Called by the replaced operator new
+	static void countAllocation(std::size_t bytes);
+};
+
+#endif // include guard
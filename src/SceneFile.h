@@ -0,0 +1,296 @@
+#ifndef INC_SCENEFILE_H
+#define INC_SCENEFILE_H
+
+#include <algorithm> // stable_sort
+#include <cctype> // isalpha
+#include <cstdint>
+#include <cstdlib> // strtof
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "ofFileUtils.h" // ofToDataPath, filesystem
+#include "ofVectorMath.h"
+#include "glm/gtc/type_ptr.hpp" // value_ptr, make_mat4
+#include "MappedFile.h"
+
+/*
+Scene description: a list of model instances with a material, a transform and
+an animation binding.
+
+The text form is one instance per line:
+
+	<model> <material> <anim> [*N] <ops...>
+
+where anim is "-" for none and ops is a sequence of
+	T x y z			translate
+	R deg x y z		rotate, in degrees, about an axis
+	S s | S x y z	scale
+applied in order, like ofTranslate/ofRotate/ofScale. "*N" repeats the line N
+times; any number may then be written "a+bi" to vary with the repeat index i.
+'#' starts a comment.
+
+The binary form is what the app loads. It is a header, a table of names and
+an array of 16-byte aligned instances, grouped by material. The file is
+memory-mapped and the instance array used in place; loading only checks that
+names are terminated and instances refer to names in the table, so nothing
+is parsed or copied.
+*/
+
+struct SceneHeader{
+	char magic[4];			// "CAKE"
+	uint32_t version;
+	uint32_t numNames;
+	uint32_t numInstances;
+	uint32_t namesOffset;	// bytes from file start
+	uint32_t instancesOffset;
+	uint32_t pad[2];
+};
+
+struct SceneName{
+	char str[32];
+};
+
+struct alignas(16) SceneInstance{
+	float transform[16];	// column-major model matrix
+	uint32_t model;			// index into name table
+	uint32_t material;		// index into name table
+	uint32_t anim;			// index into name table
+	uint32_t flags;
+};
+
+class Scene{
+public:
+	static constexpr uint32_t version = 1;
+
+	// Load a scene from its text form
+
+	// The binary form ("name.txt" -> "name") is compiled next to the text if
+	// it is missing or older, then mapped. A binary that does not map, e.g.
+	// from an older format version, is recompiled from the text once.
+	/// @param[in] textPath	Path relative to the data folder
+	bool load(const std::string& textPath){
+		mText = ofToDataPath(textPath, true);
+		mTextPath = mText;
+		mBin = mText;
+		auto ext = mBin.rfind(".txt");
+		if(ext != std::string::npos && ext + 4 == mBin.size()) mBin.erase(ext);
+		else mBin += ".bin";
+		mFile.close();
+		bool haveText = ofFile::doesFileExist(mText, false), compiled = false;
+		if(haveText){
+			mTextTime = std::filesystem::last_write_time(mText);
+			if(!ofFile::doesFileExist(mBin, false) || std::filesystem::last_write_time(mBin) < mTextTime){
+				if(!compile(mText, mBin)) return false;
+				compiled = true;
+			}
+		}
+		if(map()) return true;
+		if(!haveText || compiled) return false;
+		std::cout << " Recompiling scene " << mText << std::endl;
+		return compile(mText, mBin) && map();
+	}
+
+	// Recompile and remap if the text form changed since it was loaded
+
+	/// @return true if the scene was reloaded
+	bool reloadIfChanged(){
+		// Polled every few frames, so checks the prebuilt path without allocating
+		if(mText.empty() || !std::filesystem::exists(mTextPath)) return false;
+		auto t = std::filesystem::last_write_time(mTextPath);
+		if(t == mTextTime) return false;
+		mTextTime = t;
+		mFile.close(); // cannot overwrite a mapped file on Windows
+		bool ok = compile(mText, mBin);
+		return map() && ok;
+	}
+
+	// Compile text form into binary form (absolute paths)
+	static bool compile(const std::string& textPath, const std::string& binPath){
+		std::ifstream in(textPath);
+		if(!in){
+			std::cout << " Error opening scene " << textPath << std::endl;
+			return false;
+		}
+
+		std::vector<std::string> names;
+		auto intern = [&](const std::string& n){
+			auto it = std::find(names.begin(), names.end(), n);
+			if(it != names.end()) return uint32_t(it - names.begin());
+			names.push_back(n);
+			return uint32_t(names.size()-1);
+		};
+
+		std::vector<SceneInstance> insts;
+		std::string line;
+		int lineNum = 0;
+		while(std::getline(in, line)){
+			++lineNum;
+			line = line.substr(0, line.find('#'));
+			std::istringstream ss(line);
+			std::vector<std::string> tok;
+			for(std::string t; ss >> t;) tok.push_back(t);
+			if(tok.empty()) continue;
+
+			auto fail = [&](const char * msg){
+				std::cout << " Scene error " << textPath << ":" << lineNum << ": " << msg << std::endl;
+				return false;
+			};
+			if(tok.size() < 3) return fail("expected <model> <material> <anim>");
+			for(int k=0; k<3; ++k){
+				if(tok[k].size() >= sizeof(SceneName::str)) return fail("name too long");
+			}
+
+			size_t t = 3;
+			int repeat = 1;
+			if(t < tok.size() && tok[t][0] == '*'){
+				repeat = std::atoi(tok[t].c_str()+1);
+				if(repeat < 1) return fail("bad repeat count");
+				++t;
+			}
+
+			for(int i=0; i<repeat; ++i){
+				glm::mat4 M(1.f);
+				for(size_t k=t; k<tok.size();){
+					auto op = tok[k++];
+					float v[4];
+					int n = 0;
+					while(n<4 && k<tok.size() && !std::isalpha((unsigned char)tok[k][0])){
+						if(!number(tok[k++], i, v[n++])) return fail("bad number");
+					}
+					if(op == "T" && n == 3)			M = glm::translate(M, glm::vec3(v[0], v[1], v[2]));
+					else if(op == "R" && n == 4)	M = glm::rotate(M, glm::radians(v[0]), glm::vec3(v[1], v[2], v[3]));
+					else if(op == "S" && n == 1)	M = glm::scale(M, glm::vec3(v[0]));
+					else if(op == "S" && n == 3)	M = glm::scale(M, glm::vec3(v[0], v[1], v[2]));
+					else return fail("bad transform op");
+				}
+				SceneInstance inst{};
+				std::memcpy(inst.transform, glm::value_ptr(M), sizeof(inst.transform));
+				inst.model = intern(tok[0]);
+				inst.material = intern(tok[1]);
+				inst.anim = intern(tok[2]);
+				insts.push_back(inst);
+			}
+		}
+
+		// Group by material, then model, to minimise state changes when drawn
+		std::stable_sort(insts.begin(), insts.end(), [](const SceneInstance& a, const SceneInstance& b){
+			return a.material != b.material ? a.material < b.material : a.model < b.model;
+		});
+
+		SceneHeader h{};
+		std::memcpy(h.magic, "CAKE", 4);
+		h.version = version;
+		h.numNames = uint32_t(names.size());
+		h.numInstances = uint32_t(insts.size());
+		h.namesOffset = sizeof(SceneHeader);
+		h.instancesOffset = align16(h.namesOffset + h.numNames * sizeof(SceneName));
+
+		std::ofstream out(binPath, std::ios::binary | std::ios::trunc);
+		if(!out){
+			std::cout << " Error writing scene " << binPath << std::endl;
+			return false;
+		}
+		out.write((const char *)&h, sizeof h);
+		for(auto& n : names){
+			SceneName sn{};
+			std::strncpy(sn.str, n.c_str(), sizeof(sn.str)-1);
+			out.write((const char *)&sn, sizeof sn);
+		}
+		static const char zeros[16] = {0};
+		out.write(zeros, h.instancesOffset - (h.namesOffset + h.numNames * sizeof(SceneName)));
+		out.write((const char *)insts.data(), insts.size() * sizeof(SceneInstance));
+		return bool(out);
+	}
+
+	bool loaded() const { return mHeader != nullptr; }
+
+	uint32_t numNames() const { return mHeader ? mHeader->numNames : 0; }
+	const char * name(uint32_t i) const { return mNames[i].str; }
+
+	uint32_t size() const { return mHeader ? mHeader->numInstances : 0; }
+	const SceneInstance * begin() const { return mInstances; }
+	const SceneInstance * end() const { return mInstances + size(); }
+	const SceneInstance& operator[](uint32_t i) const { return mInstances[i]; }
+
+	static glm::mat4 transform(const SceneInstance& i){ return glm::make_mat4(i.transform); }
+
+private:
+	static uint32_t align16(uint32_t v){ return (v + 15) & ~15u; }
+
+	// Parse "a", "a+bi" or "bi" with repeat index i
+	static bool number(const std::string& s, int i, float& v){
+		const char * c = s.c_str();
+		char * end;
+		if(s.back() != 'i'){
+			v = std::strtof(c, &end);
+			return *end == '\0';
+		}
+		auto body = s.substr(0, s.size()-1);
+		size_t k = body.size();
+		while(k > 1 && !((body[k-1] == '+' || body[k-1] == '-') && body[k-2] != 'e' && body[k-2] != 'E')) --k;
+		float a = 0.f, b;
+		std::string bs = body;
+		if(k > 1){
+			a = std::strtof(body.substr(0, k-1).c_str(), &end);
+			if(*end != '\0') return false;
+			bs = body.substr(k-1);
+		}
+		if(bs.empty() || bs == "+" || bs == "-") b = bs == "-" ? -1.f : 1.f;
+		else {
+			b = std::strtof(bs.c_str(), &end);
+			if(*end != '\0') return false;
+		}
+		v = a + b * i;
+		return true;
+	}
+
+	bool map(){
+		mHeader = nullptr;
+		mNames = nullptr;
+		mInstances = nullptr;
+		if(!mFile.open(mBin)){
+			std::cout << " Error opening scene " << mBin << std::endl;
+			return false;
+		}
+		auto base = (const char *)mFile.data();
+		auto h = (const SceneHeader *)base;
+		if(mFile.size() < sizeof(SceneHeader) || std::memcmp(h->magic, "CAKE", 4) || h->version != version
+			|| mFile.size() < h->namesOffset + uint64_t(h->numNames) * sizeof(SceneName)
+			|| mFile.size() < h->instancesOffset + uint64_t(h->numInstances) * sizeof(SceneInstance)
+			|| h->instancesOffset % alignof(SceneInstance)){
+			return invalid();
+		}
+		auto names = (const SceneName *)(base + h->namesOffset);
+		auto insts = (const SceneInstance *)(base + h->instancesOffset);
+		for(uint32_t i=0; i<h->numNames; ++i){
+			if(names[i].str[sizeof(SceneName::str)-1]) return invalid();
+		}
+		for(uint32_t i=0; i<h->numInstances; ++i){
+			auto& in = insts[i];
+			if(in.model >= h->numNames || in.material >= h->numNames || in.anim >= h->numNames) return invalid();
+		}
+		mHeader = h;
+		mNames = names;
+		mInstances = insts;
+		return true;
+	}
+
+	bool invalid(){
+		std::cout << " Invalid scene file " << mBin << std::endl;
+		mFile.close();
+		return false;
+	}
+
+	MappedFile mFile;
+	const SceneHeader * mHeader = nullptr;
+	const SceneName * mNames = nullptr;
+	const SceneInstance * mInstances = nullptr;
+	std::string mText, mBin;
+	std::filesystem::path mTextPath;
+	decltype(std::filesystem::last_write_time(std::string())) mTextTime{};
+};
+
+#endif // include guard
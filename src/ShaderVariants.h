@@ -0,0 +1,145 @@
+#ifndef INC_SHADERVARIANTS_H
+#define INC_SHADERVARIANTS_H
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility> // pair
+#include <vector>
+#include "ofShader.h"
+#include "ofTexture.h"
+#include "ofGraphicsUtil.h" // build
+
+// Compile-time shader permutations
+
+// One vertex/fragment source pair is compiled into many variants. Each variant
+// is keyed by a bit field of feature flags, which are injected into the source
+// as #defines, so a variant only contains the code its features need. Variants
+// are compiled the first time they are asked for and then cached by key.
+class ShaderVariants{
+public:
+
+	// A compiled variant with its uniform locations, resolved once at link time
+	struct Program{
+		ofShader shader;
+		std::vector<GLint> locations; // in order of the names given to uniforms()
+		bool linked = false;
+
+		void begin(){ shader.begin(); }
+		void end(){ shader.end(); }
+
+		// Set a uniform by index; the program must be in use
+		void set(int u, float v) const { glUniform1f(locations[u], v); }
+		void set(int u, const glm::vec2& v) const { glUniform2fv(locations[u], 1, &v[0]); }
+		void set(int u, const glm::vec3& v) const { glUniform3fv(locations[u], 1, &v[0]); }
+		void set(int u, const glm::mat4& m) const { glUniformMatrix4fv(locations[u], 1, GL_FALSE, &m[0][0]); }
+
+		// Bind a texture to a unit and point a sampler uniform at it
+		void texture(int u, GLenum target, GLuint id, int unit) const {
+			glActiveTexture(GL_TEXTURE0 + unit);
+			glBindTexture(target, id);
+			glActiveTexture(GL_TEXTURE0);
+			glUniform1i(locations[u], unit);
+		}
+		void texture(int u, const ofTexture& t, int unit) const {
+			texture(u, t.getTextureData().textureTarget, t.getTextureData().textureID, unit);
+		}
+	};
+
+	// Set vertex and fragment program source shared by all variants
+	ShaderVariants& source(const std::string& vs, const std::string& fs, const std::string& version = "150"){
+		mVS = vs; mFS = fs; mVersion = version;
+		mShaders.clear();
+		return *this;
+	}
+
+	// Declare a flag held in bits of the key
+
+	// One-bit flags are defined only when set (#ifdef NAME). Wider flags are
+	// always defined to their value (#if NAME > 0).
+	/// @param[in] name		Preprocessor name
+	/// @param[in] mask		Contiguous bits of the key holding the flag
+	ShaderVariants& flag(const std::string& name, uint32_t mask){
+		int shift = 0, width = 0;
+		while(shift < 31 && !(mask & (1u << shift))) ++shift;
+		while(shift + width < 32 && (mask & (1u << (shift + width)))) ++width;
+		if(!width) return *this;
+		mFlags.push_back({name, shift, width});
+		return *this;
+	}
+
+	// Set #version of keys with any of the mask's bits, for flags needing newer GLSL
+	ShaderVariants& version(uint32_t mask, const std::string& version){
+		mVersions.push_back({mask, version});
+		return *this;
+	}
+
+	// Set uniform names, looked up by their index in Program::set
+	ShaderVariants& uniforms(const std::vector<std::string>& names){
+		mUniforms = names;
+		return *this;
+	}
+
+	// Attach a uniform block to a binding point in every variant
+	ShaderVariants& block(const std::string& name, GLuint binding){
+		mBlocks.push_back({name, binding});
+		return *this;
+	}
+
+	// Get the variant for a key, compiling it on first use
+	Program& get(uint32_t key){
+		auto it = mShaders.find(key);
+		if(it != mShaders.end()) return it->second;
+		auto& p = mShaders[key];
+		auto defs = defines(key);
+		auto version = mVersion;
+		for(auto& v : mVersions) if(key & v.first) version = v.second;
+		p.linked = build(p.shader, mVS, mFS, version, defs);
+		if(!p.linked){
+			std::cout << " Error building shader variant:\n" << defs << std::endl;
+		}
+
+		// Names are resolved here once; unused ones get -1, which GL ignores
+		GLuint id = p.shader.getProgram();
+		for(auto& name : mUniforms) p.locations.push_back(id ? glGetUniformLocation(id, name.c_str()) : -1);
+		for(auto& b : mBlocks){
+			GLuint index = id ? glGetUniformBlockIndex(id, b.first.c_str()) : GL_INVALID_INDEX;
+			if(index != GL_INVALID_INDEX) glUniformBlockBinding(id, index, b.second);
+		}
+		return p;
+	}
+
+	// Get the #define lines for a key
+	std::string defines(uint32_t key) const {
+		std::string d;
+		for(auto& f : mFlags){
+			uint32_t v = (key >> f.shift) & (0xFFFFFFFFu >> (32 - f.width));
+			if(f.width == 1){
+				if(v) d += "#define " + f.name + "\n";
+			} else {
+				d += "#define " + f.name + " " + std::to_string(v) + "\n";
+			}
+		}
+		return d;
+	}
+
+	// Get number of variants compiled so far
+	size_t size() const { return mShaders.size(); }
+
+private:
+	struct Flag{
+		std::string name;
+		int shift;
+		int width;
+	};
+
+	std::string mVS, mFS, mVersion;
+	std::vector<Flag> mFlags;
+	std::vector<std::pair<uint32_t, std::string>> mVersions;
+	std::vector<std::string> mUniforms;
+	std::vector<std::pair<std::string, GLuint>> mBlocks;
+	std::map<uint32_t, Program> mShaders;
+};
+
+#endif // include guard
@@ -0,0 +1,158 @@
+#ifndef INC_TEXTURECACHE_H
+#define INC_TEXTURECACHE_H
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include "ofAppRunner.h" // ofGetFrameNum
+#include "ofImage.h" // ofLoadImage
+#include "ofTexture.h"
+
+// Texture residency manager
+
+// Owns named textures loaded from image files. Pixels are uploaded to the GPU
+// and then, unless asked otherwise, the CPU copy is released. Resident GPU
+// bytes are tracked against a budget. When an upload would exceed it, the least
+// recently used textures are evicted (never ones already used this frame) and
+// re-streamed from disk the next time they are requested.
+class TextureCache{
+public:
+
+	// Set GPU memory budget, in bytes (0 = unlimited)
+	TextureCache& budget(std::size_t bytes){ mBudget = bytes; evictToFit(0); return *this; }
+	// Get GPU memory budget, in bytes
+	std::size_t budget() const { return mBudget; }
+
+	// Register a texture from an image file and upload it
+
+	/// @param[in] name			Key used to fetch the texture
+	/// @param[in] path			Image file, relative to the data folder
+	/// @param[in] keepPixels	Keep the CPU copy (re-uploads skip the disk)
+	bool load(const std::string& name, const std::string& path, bool keepPixels = false){
+		auto& e = mEntries[name];
+		evict(e);
+		e.pixels.clear();
+		e.path = path;
+		e.keepPixels = keepPixels;
+		e.arb = ofGetUsingArbTex(); // textures allocated later must match
+		return stream(e);
+	}
+
+	// Get texture, re-streaming it if evicted, and mark it used this frame
+	ofTexture& get(const std::string& name){
+		auto it = mEntries.find(name);
+		if(it == mEntries.end()){
+			std::cout << " Unknown texture " << name << std::endl;
+			static ofTexture none;
+			return none;
+		}
+		auto& e = it->second;
+		e.lastFrame = ofGetFrameNum();
+		e.lastUse = ++mTick;
+		if(!e.tex.isAllocated()) stream(e);
+		return e.tex;
+	}
+
+	// Free a texture's GPU memory; it will be re-streamed on next use
+	void evict(const std::string& name){
+		auto it = mEntries.find(name);
+		if(it != mEntries.end()) evict(it->second);
+	}
+
+	// Count GPU memory owned elsewhere against the budget, evicting to make room
+
+	/// @param[in] name		Key of the reservation; reserving again replaces it
+	/// @param[in] bytes	GPU size; 0 releases the reservation
+	void reserve(const std::string& name, std::size_t bytes){
+		auto& r = mReserved[name];
+		mResident -= r;
+		r = 0;
+		evictToFit(bytes);
+		r = bytes;
+		mResident += r;
+		if(!bytes) mReserved.erase(name);
+	}
+
+	// Get a human-readable memory report, one line per texture
+	std::string report() const {
+		std::ostringstream s;
+		s << "Textures: " << kiB(mResident) << " KiB resident";
+		if(mBudget) s << " of " << kiB(mBudget) << " KiB budget";
+		s << ", " << mEvictions << " evictions, " << mStreams << " uploads\n";
+		for(auto& kv : mEntries){
+			auto& e = kv.second;
+			s << "  " << kv.first << ": " << kiB(e.bytes) << " KiB "
+			  << (e.tex.isAllocated() ? "GPU" : "evicted")
+			  << (e.pixels.isAllocated() ? "+CPU " : " ")
+			  << e.path << "\n";
+		}
+		for(auto& kv : mReserved)
+			s << "  " << kv.first << ": " << kiB(kv.second) << " KiB reserved\n";
+		return s.str();
+	}
+
+private:
+	struct Entry{
+		std::string path;
+		ofTexture tex;
+		ofPixels pixels;		// CPU copy, only if keepPixels
+		std::size_t bytes = 0;	// GPU size estimate
+		uint64_t lastFrame = 0;	// frame of last get()
+		uint64_t lastUse = 0;	// LRU stamp
+		bool keepPixels = false;
+		bool arb = false;
+	};
+
+	static std::size_t kiB(std::size_t bytes){ return (bytes + 1023) / 1024; }
+
+	bool stream(Entry& e){
+		ofPixels loaded;
+		auto& pix = e.pixels.isAllocated() ? e.pixels : loaded;
+		if(!pix.isAllocated() && !ofLoadImage(pix, e.path)){
+			std::cout << " Error loading image file " << e.path << std::endl;
+			return false;
+		}
+		e.bytes = pix.getTotalBytes();
+		evictToFit(e.bytes);
+		e.tex.allocate(pix, e.arb);
+		mResident += e.bytes;
+		++mStreams;
+		if(e.keepPixels && &pix != &e.pixels) e.pixels = std::move(pix);
+		return true;
+	}
+
+	void evict(Entry& e){
+		if(!e.tex.isAllocated()) return;
+		e.tex.clear();
+		mResident -= e.bytes;
+		++mEvictions;
+	}
+
+	// Evict least recently used textures until extra bytes fit in the budget
+	void evictToFit(std::size_t extra){
+		if(!mBudget) return;
+		auto frame = ofGetFrameNum();
+		while(mResident + extra > mBudget){
+			Entry * lru = nullptr;
+			for(auto& kv : mEntries){
+				auto& e = kv.second;
+				if(e.tex.isAllocated() && (e.lastFrame != frame || e.lastUse == 0)
+					&& (!lru || e.lastUse < lru->lastUse)) lru = &e;
+			}
+			if(!lru) break; // everything left is in use; go over budget
+			evict(*lru);
+		}
+	}
+
+	std::map<std::string, Entry> mEntries;
+	std::map<std::string, std::size_t> mReserved; // GPU memory owned elsewhere
+	std::size_t mBudget = 0;
+	std::size_t mResident = 0;
+	uint64_t mTick = 0;
+	unsigned mEvictions = 0;
+	unsigned mStreams = 0;
+};
+
+#endif // include guard
@@ -0,0 +1,147 @@
+#ifndef INC_UNIFORMBLOCKS_H
+#define INC_UNIFORMBLOCKS_H
+
+#include <algorithm> // max
+#include <cstring> // memcpy
+#include <string>
+#include <vector>
+#include "ofGLUtils.h" // GL headers
+#include "ofVectorMath.h"
+
+/*
+Uniform data shared by the scene's shaders, in std140 uniform blocks.
+
+The Frame block holds what is the same for every draw of a pass (camera,
+time) and is written once per pass. The Object block holds what changes per
+draw (model transform); a pass writes all its objects into consecutive
+slots at once, then each draw only binds its slot's range. Both live in
+ring buffers with one segment per frame in flight, so writing never waits
+on the GPU reading an earlier frame.
+*/
+
+// Binding points of the blocks, the same in every program
+enum UniformBinding { FRAME_BLOCK = 0, OBJECT_BLOCK = 1 };
+
+struct FrameBlock{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 camera;	// camera's own transform, for sprites facing it
+	glm::vec4 eye;		// xyz = camera position
+	glm::vec4 time;		// x = seconds since start
+};
+
+struct ObjectBlock{
+	glm::mat4 model;
+};
+
+// Get GLSL declaration of the blocks
+inline std::string glslUniformBlocks(){
+	return R"(
+	layout ( std140 ) uniform Frame
+		{
+			mat4 view;
+			mat4 projection;
+			mat4 camera;
+			vec4 eye;
+			vec4 time;
+		} frame;
+
+	layout ( std140 ) uniform Object
+		{
+			mat4 model;
+		} object;
+	)";
+}
+
+
+// Ring of uniform blocks of type T, written in batches and bound by range
+template <class T>
+class UniformRing{
+public:
+
+	~UniformRing(){ clear(); }
+
+	// Set binding point and initial capacity per frame, in blocks
+	void setup(GLuint binding, size_t capacity, int frames = 3){
+		clear();
+		mBinding = binding;
+		mFrames = std::max(frames, 1);
+		GLint align = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+		mStride = (sizeof(T) + align-1) / align * align;
+		mFences.assign(mFrames, nullptr);
+		glGenBuffers(1, &mBuffer);
+		allocate(capacity);
+	}
+
+	// Move on to the next frame's segment, waiting if the GPU still reads it
+	void nextFrame(){
+		if(!mBuffer) return;
+		if(mFences[mSegment]) glDeleteSync(mFences[mSegment]);
+		mFences[mSegment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		mSegment = (mSegment + 1) % mFrames;
+		if(auto& f = mFences[mSegment]){
+			glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1e9));
+			glDeleteSync(f);
+			f = nullptr;
+		}
+		mHead = 0;
+	}
+
+	// Write n blocks into the current segment
+
+	// Blocks written earlier must already be drawn, as the ring may grow.
+	/// @return index of the first block, for bind()
+	size_t write(const T * blocks, size_t n){
+		if(!mBuffer || !n) return 0;
+		if(mHead + n > mCapacity) allocate(std::max(mCapacity * 2, mHead + n));
+		size_t first = mHead;
+		glBindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+		auto dst = (char *)glMapBufferRange(GL_UNIFORM_BUFFER, offset(first), n * mStride,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT); // fenced above
+		if(dst){
+			for(size_t i=0; i<n; ++i) std::memcpy(dst + i * mStride, &blocks[i], sizeof(T));
+			glUnmapBuffer(GL_UNIFORM_BUFFER);
+		}
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		mHead += n;
+		return first;
+	}
+
+	// Bind a written block to the binding point
+	void bind(size_t i) const {
+		glBindBufferRange(GL_UNIFORM_BUFFER, mBinding, mBuffer, offset(i), sizeof(T));
+	}
+
+	void clear(){
+		for(auto& f : mFences) if(f) glDeleteSync(f);
+		mFences.assign(mFences.size(), nullptr);
+		if(mBuffer) glDeleteBuffers(1, &mBuffer);
+		mBuffer = 0;
+	}
+
+private:
+	GLintptr offset(size_t i) const { return GLintptr((mSegment * mCapacity + i) * mStride); }
+
+	// (Re)allocate storage; the old storage lives on until the GPU is done with it
+	void allocate(size_t capacity){
+		mCapacity = capacity;
+		glBindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+		glBufferData(GL_UNIFORM_BUFFER, mFrames * mCapacity * mStride, nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		for(auto& f : mFences) if(f){ glDeleteSync(f); f = nullptr; }
+		mSegment = 0;
+		mHead = 0;
+	}
+
+	GLuint mBuffer = 0;
+	GLuint mBinding = 0;
+	size_t mStride = sizeof(T);
+	size_t mCapacity = 0;	// blocks per segment
+	size_t mHead = 0;		// next free block in the segment
+	int mFrames = 3;
+	int mSegment = 0;
+	std::vector<GLsync> mFences;
+};
+
+#endif // include guard
@@ -1,10 +1,17 @@
 #include "ofMain.h"
 #include "ofApp.h"
 
-int main( ){
+int main(int argc, char* argv[]){
+	std::vector<std::string> args(argv + 1, argv + argc);
+	auto hasArg = [&](const std::string& a){ return std::find(args.begin(), args.end(), a) != args.end(); };
+
 	ofGLFWWindowSettings settings;
-	settings.setGLVersion(3, 2);		// set GL version, x, y -> x.y
+	if(hasArg("--gl43")) settings.setGLVersion(4, 3);	// GL 4.3 adds the multi-draw indirect scene path
+	else settings.setGLVersion(3, 2);		// set GL version, x, y -> x.y
 	settings.setSize(800, 600);		// set size, in pixels, of window
 	ofCreateWindow(settings);			// create window with custom settings
-	ofRunApp(new ofApp());				// run the app
+
+	auto app = new ofApp();
+	if(hasArg("--check-allocs")) app->allocCheck = 240;	// exit nonzero if steady-state frames allocate
+	return ofRunApp(app);				// run the app; exit code from ofExit
 }
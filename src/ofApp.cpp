@@ -1,49 +1,8 @@
 #include "ofApp.h"
 using namespace glm;
 
-//Adds a rectangle lying on the xy plane centered around the given position
-static void addRect(ofFloatColor col, ofMesh& m, glm::vec3 pos, float w = 2.f, float h = 2.f) {
-	float w_2 = w * 0.5;
-	float h_2 = h * 0.5;
-	int Nv = m.getVertices().size();
-	m.setMode(OF_PRIMITIVE_TRIANGLES);
-	m.addVertex(pos + vec3(-w_2, -h_2, 0.));
-	m.addVertex(pos + vec3(w_2, -h_2, 0.));
-	m.addVertex(pos + vec3(w_2, h_2, 0.));
-	m.addVertex(pos + vec3(-w_2, h_2, 0.));
-	m.addTriangle(Nv + 0, Nv + 1, Nv + 2);
-	m.addTriangle(Nv + 0, Nv + 2, Nv + 3);
-
-	//Adds colour to vertices
-	for (auto& p : m.getVertices()) m.addColor(col);
-}
-
-//Adds a custom quad mesh with texture co-ordinates and normals
-static void addQuad(ofMesh& m, glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 d, ofFloatColor col)
-{
-	//Creates vertex's of quad
-	m.addVertex(a);
-	m.addVertex(b);
-	m.addVertex(c);
-	m.addVertex(d);
-
-	//Adds texture co-ords
-	m.addTexCoord(vec2(0, 0));
-	m.addTexCoord(vec2(1, 0));
-	m.addTexCoord(vec2(1, 1));
-	m.addTexCoord(vec2(0, 1));
-
-	//Triangles
-	m.addTriangle(0, 1, 2);
-	m.addTriangle(0, 2, 3);
-
-	//Colour + Normals
-	for (auto& p : m.getVertices()) m.addNormal(normalize(-p));
-	for (auto& p : m.getVertices()) m.addColor(col);
-}
-
-
 //LIGHTING---------------------------------------------------------------------------------------------------------------------------
+//Lighting.h has a C++ copy of this; keep the two in step
 static std::string glslLighting() {
 	return R"(
 	struct Light 
@@ -114,7 +73,6 @@ void ofApp::setup() {
 
 	//BG
 	  backgroundMesh = ofMesh::sphere(cam.getFarClip() * 0.85);
-	  if (!background.load("background.jpg")) std::cout << " Error loading envir map " << std::endl;
 
 	//Sound
 	  song.load("Happy_Birthday.wav");
@@ -125,168 +83,169 @@ void ofApp::setup() {
 	  ofDisableArbTex();
 	  ofEnableNormalizedTexCoords();
 
-	//Image loading
-	  if (!image.load("icing.jpg")) std::cout << " Error loading image file " << std::endl;
-	  if (!image2.load("polkaDot.jpg")) std::cout << " Error loading image file " << std::endl;
-	  if (!image3.load("spongeCake.jpg")) std::cout << " Error loading image file " << std::endl;
-	  if (!image4.load("paperTexture.jpg")) std::cout << " Error loading image file " << std::endl;
-	  if (!image5.load("icing2.jpg")) std::cout << " Error loading image file " << std::endl;
-	  if (!image6.load("chocolateSponge.jpeg")) std::cout << " Error loading image file " << std::endl;
+	//Image loading (CPU copies are freed once uploaded; inactive flavours are evicted first when over budget)
+	  textures.budget(textureBudget);
+	  if (!textures.load("background", "background.jpg")) std::cout << " Error loading envir map " << std::endl;
+	  textures.load("icing", "icing.jpg");
+	  textures.load("polkaDot", "polkaDot.jpg");
+	  textures.load("sponge", "spongeCake.jpg");
+	  textures.load("paper", "paperTexture.jpg");
+	  textures.load("icing2", "icing2.jpg");
+	  textures.load("chocolateSponge", "chocolateSponge.jpeg");
 	
 	
 	//Model loading and initialising
-	  mainCake.loadModel("mainCake.dae");
-	  mainCake.disableMaterials();
-
-	  cakeSponge.loadModel("cakeSponge.dae");
-	  cakeSponge.disableMaterials();
-
-	  cream1.loadModel("cream1.dae");
-	  cream1.disableMaterials();
+	  models = {
+		  { "mainCake", &mainCake }, { "cakeSponge", &cakeSponge }, { "cream1", &cream1 },
+		  { "cream2", &cream2 }, { "cakeSlice", &cakeSlice }, { "sliceSponge", &sliceSponge },
+		  { "cakeKnife", &cakeKnife }, { "candle", &candle }, { "plate", &plate }
+	  };
+	  for (auto& m : models)
+	  {
+		  m.second->loadModel(m.first + ".dae");
+		  m.second->disableMaterials();
+	  }
 
-	  cream2.loadModel("cream2.dae");
-	  cream2.disableMaterials();
+	//Import optimisation: quantised, cache-ordered copies replace the models' own buffers
+	  for (auto& m : models)
+	  {
+		  auto& mesh = optimizedModels[m.first];
+		  if (mesh.setup(*m.second)) std::cout << " " << m.first << ": " << mesh.report() << std::endl;
+	  }
 
-	  cakeSlice.loadModel("cakeSlice.dae");
-	  cakeSlice.disableMaterials();
+	//Merged geometry and material texture array for multi-draw indirect, when the context is GL 4.3
+	  if (IndirectScene::supported())
+	  {
+		  for (auto& m : optimizedModels) indirectMeshes[m.first] = indirectScene.add(m.second);
+		  useIndirect = indirectScene.upload() && materialTextures.build({
+			  &textures.get("icing"), &textures.get("icing2"), &textures.get("sponge"),
+			  &textures.get("chocolateSponge"), &textures.get("polkaDot") }, 1024);
+		  textures.reserve("materialTextures", materialTextures.bytes()); // copies count against the texture budget
+		  std::cout << " Multi-draw indirect: " << (useIndirect ? "on" : "unavailable") << std::endl;
+	  }
 
-	  sliceSponge.loadModel("sliceSponge.dae");
-	  sliceSponge.disableMaterials();
+	//Scene layout
+	  if (scene.load("cake.scene.txt")) resolveScene();
 
-	  cakeKnife.loadModel("cakeKnife.dae");
-	  cakeKnife.disableMaterials();
+	//Dynamic resolution, holding the 40 fps frame budget
+	  resolution.budget(25.).range(0.5, 1.);
 
-	  candle.loadModel("candle.dae");
-	  candle.disableMaterials();
+	//Stats overlay text, formatted in place every frame
+	  statsText.reserve(256);
 
-	  plate.loadModel("plate.dae");
-	  plate.disableMaterials();
+	//Allocation self-check, with the render scale pinned so buffers keep their size
+	  if (allocCheck)
+	  {
+		  Profiler::trackAllocations(true);
+		  resolution.range(1., 1.);
+	  }
 
 	//Variable setup
 	  candlesOn = true;
 	  vanillaCake = true;
 	  animationY.para();
 
-	//CUSTOM TEXTURE SHADER--------------------------------------------------------------------------------------------------
-	build(textureShader, R"(
+	//Uniform blocks: camera data per pass, transforms per draw
+	  frameBlocks.setup(FRAME_BLOCK, 8);
+	  objectBlocks.setup(OBJECT_BLOCK, 512);
+
+	//Uniform names, resolved once per variant when it links; order matches the Uniform enum
+	  std::vector<std::string> uniformNames = {
+		  "tex", "background", "texArray", "diffuse", "shine", "reflectivity", "texturing", "spriteRadius", "lightmap", "lightmapMatrix",
+		  "texelSize", "sharpness"
+	  };
+	  for (auto& name : MultiView::uniformNames()) uniformNames.push_back(name);
+
+	//LIT SHADER PERMUTATIONS------------------------------------------------------------------------------------------------
+	//Textured, reflective and vertex-coloured surfaces lit by the scene's three lights; each variant only compiles what its flags need
+	litShaders.source(MultiView::glslVertex() + glslUniformBlocks() + IndirectScene::glsl() + R"(
 		// Vertex program
-		uniform mat4 modelViewProjectionMatrix;
-		uniform mat4 projectionMatrix;
-		uniform mat4 viewMatrix;
-		uniform mat4 modelMatrix;
+		#ifdef INDIRECT
+		layout ( location = 4 ) in uint drawIndex; // read at the draw's base instance
+		flat out uint vdraw;
+		#define modelMatrix draws[ drawIndex ].model
+		#else
+		#define modelMatrix object.model
+		#endif
 
-		in vec2 texcoord; // texture coordinate ( vertex attribute from mesh )
 		in vec4 position;
 		in vec3 normal;
-		in vec3 color;
 
 		out vec3 vposition;
 		out vec3 vnormal;
-		out vec3 vcolor;
+
+		#ifdef TEXTURED
+		in vec2 texcoord; // texture coordinate ( vertex attribute from mesh )
 		out vec2 vtexcoord; // passed to fragment shader
+		#endif
+
+		#ifdef VERTEX_COLOR
+		in vec3 color;
+		out vec3 vcolor;
+		#endif
+
+		#ifdef LIGHTMAPPED
+		uniform mat4 lightmapMatrix; // world position to lightmap coordinate
+		out vec2 vlightmapcoord;
+		#endif
 
 		void main () 
 			{
+				#ifdef TEXTURED
 				vtexcoord = texcoord ;
+				#endif
+				#ifdef VERTEX_COLOR
 				vcolor = color ;
+				#endif
+				#ifdef INDIRECT
+				vdraw = drawIndex ;
+				#endif
 				vnormal = normal ;
 				vposition = ( modelMatrix * position ). xyz ;
-				gl_Position = projectionMatrix * viewMatrix * vec4 ( vposition , 1.) ;
+				#ifdef LIGHTMAPPED
+				vlightmapcoord = ( lightmapMatrix * vec4 ( vposition , 1.) ).xy ;
+				#endif
+				gl_Position = viewClip ( frame.projection * frame.view * vec4 ( vposition , 1.) , vec4 ( vposition , 1.) );
 			}
-		)", glslLighting() + R"(
+		)", glslLighting() + MultiView::glslFragment() + glslUniformBlocks() + IndirectScene::glsl() + LightmapBaker::glsl() + R"(
 		//Fragment program
-		uniform vec3 eye;
-		uniform sampler2D tex; // texture (ID) passed in from the CPU
-		uniform float texturing;
+		uniform vec3 diffuse; // material colour, if not textured
+		uniform float shine;
+
+		#ifdef INDIRECT
+		uniform sampler2DArray texArray; // material textures, layer chosen per draw
+		flat in uint vdraw;
+		#endif
 
 		in vec3 vposition;
 		in vec3 vnormal;
-		in vec3 vcolor;
-		in vec2 vtexcoord; // interpolant from vertex shader
 
 		out vec4 fragColor;
-		
-		void main() 
-			{
-				vec3 pos = vposition ;
-				vec3 normal = normalize ( vnormal );
 
-				//First light, white, positioned in top right corner.
-				Light light1 ;
-				light1.pos = vec3 (0.5 , 1.5 , -0.5) ;
-				light1 . strength = 1.5;
-				light1 . halfDist = 1.;
-				light1 . ambient = 0.8;
-				light1 . diffuse = vec3 (1. ,1. ,1.) ;
-				light1 . specular = light1 . diffuse ;
-
-				//Second light, blue, positioned in bottom right corner.
-				Light light2 = light1 ;
-				light2 . pos = vec3 (0. , -0.95 ,0.) ;
-				light2 . diffuse = vec3 (0. ,0. ,1.) ;
-				light2 . specular = light2 . diffuse ;
-				
-				//Third light, white, positioned in bottom left corner.
-				Light light3 = light1 ;
-				light3.strength = 0.7;
-				light3 . pos = vec3 (-0.7 , -0.6 ,0.) ;
-				light3 . diffuse = vec3 (1. ,1. ,1.) ;
-				light3 . specular = light1 . diffuse ;
-
-				Material mtrl ;
-				mtrl . diffuse = texture ( tex , vtexcoord ).rgb ;
-				mtrl . specular = vec3 (1.) ;
-				mtrl . shine = 100.;
-				LightFall fall = computeLightFall ( pos , normal , eye , light1 , mtrl );
-				addTo ( fall , computeLightFall ( pos , normal , eye , light2 , mtrl ));
-				addTo ( fall , computeLightFall ( pos , normal , eye , light3 , mtrl ));
-				vec3 col = lightColor ( fall , mtrl );
-		
-				col = mix ( vcolor , col , texturing );
-				fragColor = vec4 ( col , 1.);
-			}
-	)");
-	//Texture images
-	  auto& tex = image.getTexture();
-	  auto& tex2 = image2.getTexture();
-	  auto& tex3 = image3.getTexture();
-	  auto& tex4 = image4.getTexture();
-	  auto& tex5 = image5.getTexture();
-	  auto& tex6 = image6.getTexture();
-
-	//CUSTOM REFLECTION SHADER-----------------------------------------------------------------------------
-	build(mirrorShader, R"(
-		//Vertex program
-		uniform mat4 projectionMatrix;
-		uniform mat4 viewMatrix;
-		uniform mat4 modelMatrix;
+		#ifdef TEXTURED
+		uniform sampler2D tex; // texture (ID) passed in from the CPU
+		in vec2 vtexcoord; // interpolant from vertex shader
+		#endif
 
-		in vec4 position;
-		in vec3 normal;
-		in vec3 color;
+		#ifdef VERTEX_COLOR
+		in vec3 vcolor;
+		#endif
 
-		out vec3 vposition;
-		out vec3 vnormal;
-		out vec3 vcolor;
+		#if defined(TEXTURED) && defined(VERTEX_COLOR)
+		uniform float texturing;
+		#endif
 
-		void main () 
-			{
-				vcolor = color;
-				vnormal = normal;
-				vposition = ( modelMatrix * position ).xyz;
-				gl_Position = projectionMatrix * viewMatrix * vec4 ( vposition , 1.);
-			}
+		#ifdef LIGHTMAPPED
+		uniform sampler2D lightmap; // baked diffuse light, over lightmapRange
+		uniform mat4 lightmapMatrix; // row 2 is the direction the baked side faces
+		in vec2 vlightmapcoord;
+		#endif
 
-		)", glslLighting() + R"(
-		//Fragment program
-		uniform vec3 eye ;
+		#ifdef REFLECTION
 		uniform sampler2D background;
-
-		in vec3 vposition;
-		in vec3 vnormal;
-		in vec3 vcolor;
-
-		out vec4 fragColor;
+		#ifndef INDIRECT
+		uniform float reflectivity;
+		#endif
 
 		vec3 calcReflection ( vec3 I , vec3 N , in sampler2D background )
 			{
@@ -300,12 +259,10 @@ void ofApp::setup() {
                     // Lookup the color from the environment map
                     return texture (background , uv).rgb;
               }
+		#endif
 
-		void main () 
+		Light sceneLight ( int i )
 			{
-				vec3 pos = vposition;
-				vec3 normal = normalize (vnormal);
-				
 				//First light, white, positioned in top right corner.
 				Light light1 ;
 				light1.pos = vec3 (0.5 , 1.5 , -0.5) ;
@@ -314,50 +271,101 @@ void ofApp::setup() {
 				light1 . ambient = 0.8;
 				light1 . diffuse = vec3 (1. ,1. ,1.) ;
 				light1 . specular = light1 . diffuse ;
+				if ( i == 0 ) return light1 ;
 
 				//Second light, blue, positioned in bottom right corner.
 				Light light2 = light1 ;
 				light2 . pos = vec3 (0. , -0.95 ,0.) ;
 				light2 . diffuse = vec3 (0. ,0. ,1.) ;
 				light2 . specular = light2 . diffuse ;
-				
+				if ( i == 1 ) return light2 ;
+
 				//Third light, white, positioned in bottom left corner.
 				Light light3 = light1 ;
 				light3.strength = 0.7;
 				light3 . pos = vec3 (-0.7 , -0.6 ,0.) ;
 				light3 . diffuse = vec3 (1. ,1. ,1.) ;
 				light3 . specular = light1 . diffuse ;
+				return light3 ;
+			}
+
+		vec3 litColor ( vec3 pos , vec3 normal , vec3 eyePos , Material mtrl )
+			{
+				LightFall fall = computeLightFall ( pos , normal , eyePos , sceneLight (0) , mtrl );
+				for ( int i = 1; i < 3; ++i )
+					addTo ( fall , computeLightFall ( pos , normal , eyePos , sceneLight (i) , mtrl ));
+				return lightColor ( fall , mtrl );
+			}
+		
+		void main() 
+			{
+				vec3 pos = vposition ;
+				vec3 normal = normalize ( vnormal );
+				vec3 eyePos = viewEye ( frame.eye.xyz );
+
+				Material mtrl ;
+				#if defined(INDIRECT)
+				Draw d = draws[ vdraw ];
+				mtrl . diffuse = d . diffuse . a < 0. ? d . diffuse . rgb : texture ( texArray , vec3 ( vtexcoord , d . diffuse . a ) ).rgb ;
+				mtrl . shine = d . material . x ;
+				float reflectivity = d . material . y ;
+				#elif defined(TEXTURED)
+				mtrl . diffuse = texture ( tex , vtexcoord ).rgb ;
+				mtrl . shine = shine ;
+				#else
+				mtrl . diffuse = diffuse ;
+				mtrl . shine = shine ;
+				#endif
+				mtrl . specular = vec3 (1.) ;
 
-				Material mtrl;
-				mtrl.diffuse = vec3(0.2, 0.4, 0.7).rgb;
-				mtrl.specular = vec3(1.,1.,1.);
-				mtrl.shine = 200.;
-				LightFall fall = computeLightFall ( pos , normal , eye , light1 , mtrl );
-				addTo ( fall , computeLightFall ( pos , normal , eye , light2 , mtrl ));
-				addTo ( fall , computeLightFall ( pos , normal , eye , light3 , mtrl ));
-				vec3 col = lightColor ( fall , mtrl );
-				vec3 I = - normalize ( eye - pos ); // incident ray
-
-				//Adds reflection
-				float reflectivity = 0.7;
-				vec3 reflCol = calcReflection (I , normal , background );
-				col = mix ( col , reflCol , reflectivity );
+				#ifdef LIGHTMAPPED
+				// Baked light where the visible side faces the lightmap's front; rims and undersides are lit live
+				vec3 facing = normalize ( cross ( dFdx ( pos ) , dFdy ( pos ) ) );
+				facing *= sign ( dot ( facing , eyePos - pos ) );
+				vec3 front = vec3 ( lightmapMatrix[0][2] , lightmapMatrix[1][2] , lightmapMatrix[2][2] );
+				vec3 col = dot ( facing , front ) >= lightmapMinFacing
+					? mtrl . diffuse * textureLod ( lightmap , vlightmapcoord , 0. ).rgb * lightmapRange
+					: litColor ( pos , normal , eyePos , mtrl );
+				#else
+				vec3 col = litColor ( pos , normal , eyePos , mtrl );
+				#endif
+
+				#ifdef REFLECTION
+				vec3 I = - normalize ( eyePos - pos ); // incident ray
+				col = mix ( col , calcReflection (I , normal , background ) , reflectivity );
+				#endif
+
+				#if defined(TEXTURED) && defined(VERTEX_COLOR)
+				col = mix ( vcolor , col , texturing );
+				#elif defined(VERTEX_COLOR)
+				col = vcolor ;
+				#endif
 				fragColor = vec4 ( col , 1.);
-			}	
-	)");
+			}
+	)").flag("TEXTURED", TEXTURED).flag("VERTEX_COLOR", VERTEX_COLOR).flag("REFLECTION", REFLECTION)
+	   .flag("MULTIVIEW", MULTIVIEW).flag("INDIRECT", INDIRECT).flag("LIGHTMAPPED", LIGHTMAPPED).version(INDIRECT, "430")
+	   .uniforms(uniformNames).block("Frame", FRAME_BLOCK).block("Object", OBJECT_BLOCK);
+
+	//The indirect path is only kept if its variant links; otherwise the scene draws per object
+	  if (useIndirect && !litShaders.get(INDIRECT | TEXTURED | REFLECTION).linked)
+	  {
+		  useIndirect = false;
+		  std::cout << " Multi-draw indirect: shader failed to link, drawing per object" << std::endl;
+	  }
+	  indirectReady = useIndirect;
 
 
-	//POINT SPRITES SHADER-----------------------------------------------------------------------------------
-	build(pointShader, R"(
+	//POINT SPRITE PERMUTATIONS-----------------------------------------------------------------------------------
+	spriteShaders.source(MultiView::glslVertex() + glslUniformBlocks() + R"(
 			//Vertex program
-			uniform mat4 modelViewProjectionMatrix;
 			uniform float spriteRadius;
-			uniform mat4 cameraMatrix;
 		
-			in vec3 color;
 			in vec4 position;
 
+			#ifdef VERTEX_COLOR
+			in vec3 color;
 			out vec3 vcolor;
+			#endif
 			out vec2 vtexcoord ; // passed to fragment shader
 			out vec2 spriteCoord; // sprite coordinate in [ -1 ,1]
 
@@ -372,20 +380,29 @@ void ofApp::setup() {
 						case 3: spriteCoord = vec2 ( -1. , 1.) ; break;
 					}
 
+					#ifdef VERTEX_COLOR
 					vcolor = color;
+					#endif
 					vec4 offset = vec4 ( spriteCoord * spriteRadius , 0. , 0.);
-					offset = cameraMatrix * offset;
+					offset = viewCamera ( frame.camera ) * offset;
 					pos += offset;
 					vtexcoord = spriteCoord;
-					gl_Position = modelViewProjectionMatrix * pos;
+					vec4 world = object.model * pos;
+					gl_Position = viewClip ( frame.projection * frame.view * world , world );
 				}
 
 			)", R"(
 			// Fragment program
+			#ifdef TEXTURED
 			uniform sampler2D tex; 
+			#endif
+			#if defined(TEXTURED) && defined(VERTEX_COLOR)
 			uniform float texturing ;
+			#endif
 
+			#ifdef VERTEX_COLOR
 			in vec3 vcolor ;
+			#endif
 			in vec2 vtexcoord ;
 			in vec2 spriteCoord; //sprite coordinate in [ -1 ,1]
 
@@ -394,10 +411,15 @@ void ofApp::setup() {
 				{
 					float rsqr = dot( spriteCoord, spriteCoord);
 					if( rsqr > 1.) discard;
-					//vec3 col = vec3(1,1,0);
-					//vec3 col = texture(tex, vtexcoord).rgb;
+					#if defined(TEXTURED) && defined(VERTEX_COLOR)
+					vec3 col = mix ( vcolor , texture ( tex , vtexcoord ). rgb , texturing );
+					#elif defined(TEXTURED)
 					vec3 col = texture ( tex , vtexcoord ). rgb ;
-					col = mix ( vcolor , col , texturing );
+					#elif defined(VERTEX_COLOR)
+					vec3 col = vcolor ;
+					#else
+					vec3 col = vec3 (1.) ;
+					#endif
 
 					float a = 1. - rsqr ; // inverted parabola
 					float w = 0.5; // attenuation width
@@ -406,32 +428,85 @@ void ofApp::setup() {
 					col *= a;
 					fragColor = vec4(col, 1.);
 				}
-		)");
+		)").flag("TEXTURED", TEXTURED).flag("VERTEX_COLOR", VERTEX_COLOR).flag("MULTIVIEW", MULTIVIEW)
+		   .uniforms(uniformNames).block("Frame", FRAME_BLOCK).block("Object", OBJECT_BLOCK);
+
+	//SKY PERMUTATIONS----------------------------------------------------------------------------------------------
+	skyShaders.source(MultiView::glslVertex() + glslUniformBlocks() + R"(
+			//Vertex program
+			in vec4 position;
+			in vec2 texcoord;
+
+			out vec2 vtexcoord;
+
+			void main()
+				{
+					vtexcoord = texcoord;
+					vec4 world = object.model * position;
+					gl_Position = viewClip ( frame.projection * frame.view * world , world );
+				}
+
+			)", R"(
+			// Fragment program
+			uniform sampler2D tex;
+
+			in vec2 vtexcoord;
+
+			out vec4 fragColor;
+			void main()
+				{
+					fragColor = texture ( tex , vtexcoord );
+				}
+		)").flag("MULTIVIEW", MULTIVIEW)
+		   .uniforms(uniformNames).block("Frame", FRAME_BLOCK).block("Object", OBJECT_BLOCK);
+
+	//UPSCALE SHADER-------------------------------------------------------------------------------------------
+	upscaleShader.source(R"(
+			//Vertex program
+			uniform mat4 modelViewProjectionMatrix;
+
+			in vec4 position;
+			in vec2 texcoord;
+
+			out vec2 vtexcoord;
+
+			void main()
+				{
+					vtexcoord = texcoord;
+					gl_Position = modelViewProjectionMatrix * position;
+				}
+
+			)", R"(
+			// Fragment program
+			uniform sampler2D tex;
+			uniform vec2 texelSize;
+			uniform float sharpness; // 0 for plain bilinear upscaling
+
+			in vec2 vtexcoord;
+
+			out vec4 fragColor;
+			void main()
+				{
+					vec3 c = texture ( tex , vtexcoord ).rgb;
+					vec3 n = texture ( tex , vtexcoord + vec2 (0. , texelSize.y) ).rgb;
+					vec3 s = texture ( tex , vtexcoord - vec2 (0. , texelSize.y) ).rgb;
+					vec3 e = texture ( tex , vtexcoord + vec2 (texelSize.x , 0.) ).rgb;
+					vec3 w = texture ( tex , vtexcoord - vec2 (texelSize.x , 0.) ).rgb;
+
+					// Unsharp mask, limited to the neighbourhood range so edges do not ring
+					vec3 lo = min ( c , min ( min (n , s) , min (e , w) ) );
+					vec3 hi = max ( c , max ( max (n , s) , max (e , w) ) );
+					vec3 col = c + sharpness * (4.*c - n - s - e - w);
+					fragColor = vec4 ( clamp ( col , lo , hi ) , 1.);
+				}
+		)").uniforms(uniformNames);
 
 	//Noise texture
 	  int W = 512, H = W;
 	  auto format = GL_LUMINANCE;
 	  ofPixels pix; // 2D array of unsigned char
 	  pix.allocate(W, H, OF_PIXELS_GRAY);
-	  for (int j = 0; j < H; ++j)
-	  {
-		for (int i = 0; i < W; ++i)
-		{
-			auto uv = vec2(i, j) / (vec2(W, H) - 1.f);
-			float val = 0.;
-			int octaves = 6;
-			float f = 2.; // starting frequency
-			float Asum = 0.; // used to scale final amplitude into [0,1]
-			for (int k = 1; k <= octaves; ++k)
-			{
-				float A = 1. / f;
-				val += A * ofNoise(uv * f);
-				f *= 2.f;
-				Asum += A;
-			}
-			pix[j * W + i] = val / Asum * 255;
-		}
-	  }
+	  fbmNoise(pix);
 	  noiseTex.allocate(pix);
 
 	//Point sprite meshes
@@ -452,225 +527,552 @@ void ofApp::setup() {
 	  addQuad(wall2, vec3(-1.5, -0.6, -1.5), vec3(-1.5, -0.6, 1.6), vec3(-1.5, 1.5, 1.6), vec3(-1.5, 1.5, -1.5), ofFloatColor(1, 1, 1));
 	  addQuad(wall3, vec3(1.5, -0.6, -1.5), vec3(1.5, -0.6, 1.6), vec3(1.5, 1.5, 1.6), vec3(1.5, 1.5, -1.5), ofFloatColor(1, 1, 1));
 	  addQuad(floor, vec3(1.5, -0.6, -1.5), vec3(-1.5, -0.6, -1.5), vec3(-1.5, -0.6, 1.6), vec3(1.5, -0.6, 1.6), ofFloatColor(1, 1, 1));
+
+	//Lightmaps for the static surfaces, baked on all cores or loaded from the cache
+	  bakeLightmaps();
 	
 }
 
 //--------------------------------------------------------------
 void ofApp::update() {
+	//Closes the last frame's profile and releases its scratch memory
+	Profiler::endFrame();
+	frameArena.reset();
+	if (allocCheck) checkAllocations();
+	Profiler::Scope profile("update");
+
 	//Delta seconds of last frame render
 	float dt = ofGetLastFrameTime()/ 10;
 
 	//Update animations
 	input += 0.1;
-	for (auto& a : { &animationY })
-		a->update(dt);
+	if (animating)
+		for (auto& a : { &animationY })
+			a->update(dt);
+
+	//Picks up edits to the scene layout about once a second
+	if (ofGetFrameNum() % 40 == 0 && scene.reloadIfChanged())
+	{
+		resolveScene();
+		bakeLightmaps();
+	}
 }
 
 //--------------------------------------------------------------
-void ofApp::draw() {
-	
-	//Animation updates
-	  float cakeSliceY = animationY.para();
-	  mappedSin = ofMap(sin(input), -1, 1, -0.012, 0.012);
+void ofApp::checkAllocations() {
 
-	//Setup
-	  cam.begin();
-	  ofEnableLighting();
+	//Skips warm-up, where shaders compile, textures stream and buffers grow
+	  const int warmup = 60;
+	  if (ofGetFrameNum() <= warmup) return;
 
-	//Texture shader
-	  textureShader.begin();
-	  if (vanillaCake)
+	//Any allocation in a profiled scope fails the frame; the framework's loop between callbacks is only reported
+	  bool clean = true;
+	  for (int i = 1; i < Profiler::numScopes(); ++i)
+		  clean = clean && Profiler::scope(i).allocs == 0;
+	  if (!clean)
 	  {
-		  textureShader.setUniformTexture("tex", image, 0);
+		  Profiler::trackAllocations(false); // not counting the report itself
+		  std::cout << " Frame " << ofGetFrameNum() - 1 << " allocated:\n" << Profiler::report();
+		  Profiler::trackAllocations(true);
+		  ++allocCheckFailures;
 	  }
-	  else
+
+	  if (ofGetFrameNum() >= warmup + allocCheck)
 	  {
-  		  textureShader.setUniformTexture("tex", image5, 0);
+		  std::cout << " Allocation check: " << allocCheckFailures << " of " << allocCheck << " frames allocated" << std::endl;
+		  ofExit(allocCheckFailures ? 1 : 0);
 	  }
-	  textureShader.setUniform1f("texturing", 1.);
-	  textureShader.setUniform3f("eye", cam.getPosition());
-
-	//Main cake icing
-	  ofPushMatrix();
-	  ofTranslate(0, -0.5, 0);
-	  ofRotate(200, 0, 1, 0);
-	  ofScale(0.005);
-	  mainCake.drawFaces();
-	  ofPopMatrix();
+}
 
+//--------------------------------------------------------------
+void ofApp::draw() {
+	  Profiler::Scope profile("draw");
 	
-	  for (int i = 0; i < 28; i++)
-	  {
-		 ofPushMatrix();
-		  ofTranslate(0., -0.5, 0);
-		  ofRotate(57 + 360 / 32.9 * i, 0, 1, 0);
-		  ofScale(0.00058);
-		  cream2.drawFaces();
-		  ofPopMatrix();
-	  }
+	//Animation updates
+	  mappedSin = ofMap(sin(input), -1, 1, -0.012, 0.012);
 
-	  for (int i = 0; i < 6; i++)
+	//Uniform rings move on to this frame's segment
+	  frameBlocks.nextFrame();
+	  objectBlocks.nextFrame();
+
+	//Catalogue turntable, rendered before the frame so it shares its animation state
+	  if (turntableRequested)
 	  {
-		  ofPushMatrix();
-		  ofTranslate(0, -0.37, 0);
-		  ofRotate(70 + 360 / 7 * i, 0, 1, 0);
-		  ofScale(0.0009);
-		  cream1.drawFaces();
-		  ofPopMatrix();
+		  Profiler::Scope profile("turntable");
+		  renderTurntable();
+		  turntableRequested = false;
 	  }
 
-	//Cake slice icing
-	  ofPushMatrix();
-	  ofTranslate(-0.1, -0.45 + cakeSliceY, -0.2);
-	  ofRotate(200, 0, 1, 0);
-	  ofScale(0.0025);
-	  cakeSlice.drawFaces();
-	  ofPopMatrix();
-
-	  ofPushMatrix();
-	  ofTranslate(0, -0.37 + cakeSliceY, 0.40);
-	  ofRotate(37, 0, 1, 0);
-	  ofScale(0.0009);
-	  cream1.drawFaces();
-	  ofPopMatrix();
-
-
-	  for (int i = 0; i < 4; i++)
+	//Scene, rendered at a scale that keeps GPU time within budget
+	  resolution.beginFrame();
+	  auto size = resolution.size(ofGetWidth(), ofGetHeight());
+	  if (!sceneFbo.isAllocated() || sceneFbo.getWidth() != size.x || sceneFbo.getHeight() != size.y)
 	  {
-		  ofPushMatrix();
-		  ofTranslate(0.1, -0.47 + cakeSliceY, 0.25);
-		  ofRotate((i * 12), 0, 1, 0);
-		  ofRotate(3.8, 0, 1, 0);
-		  ofScale(0.00058);
-		  cream2.drawFaces();
-		  ofPopMatrix();
+		  ofFbo::Settings settings;
+		  settings.width = size.x;
+		  settings.height = size.y;
+		  settings.internalformat = GL_RGB;
+		  settings.useDepth = true;
+		  sceneFbo.allocate(settings);
+		  staticFbo.allocate(settings);
+		  screenQuad.clear();
 	  }
-	
-	  if (vanillaCake)
+	  cam.setControlArea(ofGetWindowRect()); // mouse still maps to the whole window
+
+	//Only redraws what changed: nothing when idle, just the dynamic layer when only animations move
+	  auto state = currentFrameState(size);
+	  const char* redraw = "none";
+	  if (!(state == frameState))
 	  {
-		  textureShader.setUniformTexture("tex3", image3, 0);
+		  Profiler::Scope profile("scene");
+		  redraw = "dynamic";
+		  if (!state.sameStatic(frameState))
+		  {
+			  redraw = "full";
+			  staticFbo.begin();
+			  ofClear(0);
+			  cam.begin();
+			  drawWorld(STATIC_LAYER);
+			  cam.end();
+			  staticFbo.end();
+		  }
+
+		  //Static layer's colour and depth, so it still hides dynamic objects behind it
+		  glBindFramebuffer(GL_READ_FRAMEBUFFER, staticFbo.getId());
+		  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sceneFbo.getId());
+		  glBlitFramebuffer(0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		  sceneFbo.begin();
+		  cam.begin();
+		  drawWorld(DYNAMIC_LAYER);
+		  cam.end();
+		  sceneFbo.end();
+		  frameState = state;
 	  }
-	  else
+
+	//Upscale to the window, sharpening more the lower the scale
 	  {
-		  textureShader.setUniformTexture("tex6", image6, 0);
+		  Profiler::Scope profile("upscale");
+		  //Window quad built once per size; ofFbo::draw would build a new mesh every frame
+		  if (screenQuad.getNumVertices() == 0)
+		  {
+			  auto quad = sceneFbo.getTexture().getMeshForSubsection(0, 0, 0, ofGetWidth(), ofGetHeight(),
+				  0, 0, size.x, size.y, ofGetCurrentRenderer()->isVFlipped(), OF_RECTMODE_CORNER);
+			  screenQuad.clear();
+			  screenQuad.setMode(quad.getMode());
+			  screenQuad.append(quad);
+		  }
+		  ofDisableDepthTest();
+		  auto& upscale = upscaleShader.get(0);
+		  upscale.begin();
+		  upscale.texture(TEX_UNIFORM, sceneFbo.getTexture(), 0);
+		  upscale.set(TEXEL_SIZE_UNIFORM, vec2(1. / size.x, 1. / size.y));
+		  upscale.set(SHARPNESS_UNIFORM, ofMap(resolution.scale(), 1., 0.5, 0., 0.25, true));
+		  screenQuad.draw();
+		  upscale.end();
+		  resolution.endFrame();
 	  }
 
-	//Main cake sponge
-	  for (int i = 0; i < 2; i++)
+	//UI, at native resolution, formatted into frame scratch memory
+	  if (showStats)
 	  {
-		  ofPushMatrix();
-		  ofTranslate(0, -0.5 + (i*-0.475), 0);
-		  ofRotate(200, 0, 1, 0);
-		  ofScale(0.0025);
-		  cakeSponge.drawFaces();
-		  ofPopMatrix();
+		  Profiler::Scope profile("ui");
+		  const int len = 256;
+		  char* text = frameArena.make<char>(len);
+		  int at = snprintf(text, len, "%.1f fps\nGPU %.2f ms%s\nscale %.2f (%dx%d)\nredraw %s",
+			  ofGetFrameRate(), resolution.gpuMs(), resolution.timerQueries() ? "" : " (glFinish)",
+			  resolution.scale(), size.x, size.y, redraw);
+		  if (Profiler::trackingAllocations() && at > 0 && at < len)
+		  {
+			  auto heap = Profiler::frame();
+			  snprintf(text + at, len - at, "\nheap %llu allocs, %llu bytes",
+				  (unsigned long long)heap.allocs, (unsigned long long)heap.bytes);
+		  }
+
+		  //Drawn from the font's reused mesh; ofDrawBitmapString* would copy, split and re-mesh the text every frame
+		  statsText.assign(text); // within the capacity reserved in setup
+		  auto& mesh = statsFont.getMesh(statsText, 10, 20, OF_BITMAPMODE_SIMPLE, ofGetCurrentRenderer()->isVFlipped());
+		  //Backdrop from the glyph quads themselves; getBoundingBox would rebuild the font's one shared mesh
+		  vec2 lo(mesh.getVertices()[0]), hi = lo;
+		  for (auto& v : mesh.getVertices())
+		  {
+			  lo = glm::min(lo, vec2(v));
+			  hi = glm::max(hi, vec2(v));
+		  }
+		  ofSetColor(0);
+		  ofDrawRectangle(lo.x - 4, lo.y - 4, hi.x - lo.x + 8, hi.y - lo.y + 8);
+		  //Glyphs are alpha-masked, as the renderer draws them for ofDrawBitmapString
+		  ofSetColor(255);
+		  ofEnableAlphaBlending();
+		  statsFont.getTexture().bind();
+		  mesh.draw();
+		  statsFont.getTexture().unbind();
+		  ofDisableAlphaBlending();
 	  }
+	  ofEnableDepthTest();
+
+}
 
-	  for (int i = 0; i < 2; i++)
+//--------------------------------------------------------------
+ofApp::FrameState ofApp::currentFrameState(glm::ivec2 size) {
+
+	//Camera, animation phases, particle motion and toggles; anything else does not show
+	  FrameState state;
+	  state.view = cam.getGlobalTransformMatrix();
+	  state.projection = cam.getProjectionMatrix(ofRectangle(0, 0, size.x, size.y));
+	  state.size = size;
+	  state.scene = sceneVersion;
+	  state.vanilla = vanillaCake;
+	  state.slice = animationY.para();
+	  state.candles = candlesOn;
+	  state.flames = candlesOn ? mappedSin : 0.f;
+	  return state;
+}
+
+//--------------------------------------------------------------
+void ofApp::drawWorld(int layers) {
+
+	//Camera data shared by every draw of the pass
+	  FrameBlock frame;
+	  frame.view = ofGetCurrentViewMatrix();
+	  frame.projection = ofGetCurrentMatrix(OF_MATRIX_PROJECTION);
+	  frame.camera = cam.getLocalTransformMatrix();
+	  frame.eye = vec4(cam.getPosition(), 1.);
+	  frame.time = vec4(ofGetElapsedTimef(), 0., 0., 0.);
+	  frameBlocks.bind(frameBlocks.write(&frame, 1));
+
+	//Opaque surfaces first, then the sky behind them, then additive sprites over everything
+	  ofEnableLighting();
 	  {
-		  ofPushMatrix();
-		  ofTranslate(0, -0.5 + (i * -0.475), 0);
-		  ofRotate(211, 0, 1, 0);
-		  ofScale(-0.0025,0.0025,0.0025);
-		  cakeSponge.drawFaces();
-		  ofPopMatrix();
+		  Profiler::Scope profile("drawScene");
+		  drawScene(layers);
 	  }
-	
-	//Cake slice sponge
-	  for (int i = 0; i < 2; i++)
+	  if (layers & STATIC_LAYER) drawRoom();
+	  ofDisableLighting();
+	  if (layers & DYNAMIC_LAYER) drawSprites();
+}
+
+//--------------------------------------------------------------
+void ofApp::drawRoom() {
+
+	//Every draw is instanced once per view when rendering multiple views
+	  int n = views.instances();
+
+	//Walls and sky are modelled in world space
+	  ObjectBlock identity = { mat4(1.) };
+	  objectBlocks.bind(objectBlocks.write(&identity, 1));
+
+	//Box walls, one texture fetch for their light when baked
+	  bool baked = useLightmaps && lightmaps.size() >= 4;
+	  auto& wallShader = beginShader(litShaders, TEXTURED | (baked ? LIGHTMAPPED : 0));
+	  wallShader.texture(TEX_UNIFORM, textures.get("paper"), 0);
+	  wallShader.set(SHINE_UNIFORM, 100.f);
+	  int surface = 0;
+	  for (auto wall : { &wall1, &wall2, &wall3, &floor })
 	  {
-		  ofPushMatrix();
-		  ofTranslate(-0.1, -0.45 + (i * -0.475) + cakeSliceY, -0.2);
-		  ofRotate(200, 0, 1, 0);
-		  ofScale(0.0025);
-		  sliceSponge.drawFaces();
-		  ofPopMatrix();
+		  if (baked)
+		  {
+			  wallShader.texture(LIGHTMAP_UNIFORM, lightmaps.texture(surface), 1);
+			  wallShader.set(LIGHTMAP_MATRIX_UNIFORM, lightmaps.projection(surface));
+		  }
+		  wall->drawInstanced(OF_MESH_FILL, n);
+		  ++surface;
 	  }
+	  wallShader.end();
+
+	//Background
+	  auto& skyShader = beginShader(skyShaders, 0);
+	  skyShader.texture(TEX_UNIFORM, textures.get("background"), 0);
+	  backgroundMesh.drawInstanced(OF_MESH_FILL, n);
+	  skyShader.end();
+}
 
-    //Plate
-	  textureShader.setUniformTexture("tex2", image2, 0);
-	  ofPushMatrix();
-	  ofTranslate(0, -0.55, 0);
-	  ofRotate(200, 0, 1, 0);
-	  ofScale(-0.007);
-	  plate.drawFaces();
-	  ofPopMatrix();
+//--------------------------------------------------------------
+void ofApp::drawSprites() {
+
+	//Every draw is instanced once per view when rendering multiple views
+	  int n = views.instances();
 
-	//Candles
-	  for (int i = 0; i < 6; i++)
-	  {
-		  ofPushMatrix();
-		  ofTranslate(0, -0.37, 0);
-		  ofRotate(70 + 360 / 7 * i, 0, 1, 0);
-		  ofPushMatrix();
-		  ofTranslate(0, 0.2, 0.08);
-		  ofScale(0.0009);
-		  candle.drawFaces();
-		  ofPopMatrix();
-		  ofPopMatrix();
-	  }
-	
-	//Box walls
-	  textureShader.setUniformTexture("tex4", image4, 0);
-	  wall1.draw();
-	  wall2.draw();
-	  wall3.draw();
-	  floor.draw();
-	  textureShader.end();
-
-	//Mirror shader
-	  mirrorShader.begin();
-	  mirrorShader.setUniform3f("eye", cam.getPosition());
-	  mirrorShader.setUniformTexture("background", background, 0);
-
-    //Cake knife
-	  ofPushMatrix();
-	  ofTranslate(-0.05, -0.47 + cakeSliceY, -0.05);
-	  ofRotate(200, 0, 1, 0);
-	  ofScale(0.005);
-	  cakeKnife.drawFaces();
-	  ofPopMatrix();
-	  mirrorShader.end();
-	
 	//Disabling
-	  ofDisableLighting();
 	  glDepthMask(GL_FALSE);
 	  ofEnableBlendMode(OF_BLENDMODE_ADD);
 
-	//Point sprite shader
-	  pointShader.begin();
-	  pointShader.setUniformTexture("tex", noiseTex, 0);
-	  pointShader.setUniformMatrix4f("cameraMatrix", cam.getLocalTransformMatrix());
-	  pointShader.setUniform1f("spriteRadius", 0.1);
-	  pointShader.setUniform1f("texturing", 0.4);
+	//Point sprite shader, without the texture or colour path when texturing makes it unused
+	  float texturing = 0.4;
+	  auto& pointShader = beginShader(spriteShaders, (texturing > 0. ? TEXTURED : 0) | (texturing < 1. ? VERTEX_COLOR : 0));
+	  pointShader.texture(TEX_UNIFORM, noiseTex, 0);
+	  pointShader.set(SPRITE_RADIUS_UNIFORM, 0.1f);
+	  pointShader.set(TEXTURING_UNIFORM, texturing);
+
+	  //Flame and sparkle transforms, written in one go
+	  ObjectBlock objects[7];
+	  for (int i = 0; i < 6; i++)
+		  objects[i].model = glm::rotate(mat4(1.), glm::radians(float(360 / 7 * i)), vec3(0, 1, 0)) * glm::translate(mat4(1.), vec3(0.6 + mappedSin, 0.80, 0.2));
+	  objects[6].model = glm::translate(mat4(1.), vec3(-1.5, -1.5, -1.5));
+	  size_t first = objectBlocks.write(objects, 7);
 	
 	  //Candle 'flames'
 	  if (candlesOn)
 	  {
 		  for (int i = 0; i < 6; i++)
 		  {
-			  ofPushMatrix();
-			  ofRotate(360 / 7 * i, 0, 1, 0);
-			  ofPushMatrix();
-			  ofTranslate(0.6 + mappedSin, 0.80, 0.2);
-			  pointMesh.draw();
-			  ofPopMatrix();
-			  ofPopMatrix();
+			  objectBlocks.bind(first + i);
+			  pointMesh.drawInstanced(OF_MESH_FILL, n);
 		  }
 	  }
 	  //Sparkles
-	  ofTranslate(-1.5, -1.5, -1.5);
-	  pointMesh2.draw();
+	  objectBlocks.bind(first + 6);
+	  pointMesh2.drawInstanced(OF_MESH_FILL, n);
 	  pointShader.end();
 	  ofDisableBlendMode();
 	  glDepthMask(GL_TRUE);
+}
 
-	//Background
-	  background.bind();
-	  backgroundMesh.draw();
-	  background.unbind();
-	  cam.end();
+//--------------------------------------------------------------
+void ofApp::renderTurntable() {
+
+	//Views orbiting the cake, one per tile
+	  int numViews = 12, cols = 4, tileSize = 256;
+	  auto viewMats = MultiView::orbit(numViews, vec3(0., -0.3, 0.), 2.2, 0.6);
+	  auto projection = glm::perspective(glm::radians(cam.getFov()), 1.f, cam.getNearClip(), cam.getFarClip());
+	  views.set(viewMats, projection, cols);
+
+	  ofFbo::Settings settings;
+	  settings.width = cols * tileSize;
+	  settings.height = views.rows() * tileSize;
+	  settings.internalformat = GL_RGB;
+	  settings.useDepth = true;
+	  if (!turntableFbo.isAllocated() || turntableFbo.getWidth() != settings.width || turntableFbo.getHeight() != settings.height)
+		  turntableFbo.allocate(settings);
+
+	//One pass renders every view into its tile
+	  turntableFbo.begin();
+	  ofClear(0);
+	  MultiView::enableClipping(true);
+	  drawWorld();
+	  MultiView::enableClipping(false);
+	  turntableFbo.end();
+	  views.clear();
+
+	  ofPixels pixels;
+	  turntableFbo.readToPixels(pixels);
+	  ofSaveImage(pixels, "turntable.png");
+	  std::cout << " Saved " << numViews << " views to turntable.png" << std::endl;
+}
 
+//--------------------------------------------------------------
+void ofApp::resolveScene() {
+
+	//Binds scene names to models, materials and animations once, so drawing is only index lookups
+	  static const std::map<std::string, int> materials = {
+		  { "icing", ICING }, { "sponge", SPONGE }, { "polkaDot", POLKADOT }, { "mirror", MIRROR }
+	  };
+	  sceneModels.assign(scene.numNames(), nullptr);
+	  sceneMeshes.assign(scene.numNames(), nullptr);
+	  sceneMaterials.assign(scene.numNames(), NO_MATERIAL);
+	  sceneAnims.assign(scene.numNames(), nullptr);
+	  sceneIndirect.assign(scene.numNames(), -1);
+	  for (uint32_t i = 0; i < scene.numNames(); ++i)
+	  {
+		  std::string name = scene.name(i);
+		  if (models.count(name)) sceneModels[i] = models[name];
+		  if (optimizedModels.count(name) && !optimizedModels[name].empty()) sceneMeshes[i] = &optimizedModels[name];
+		  if (materials.count(name)) sceneMaterials[i] = materials.at(name);
+		  if (name == "slice") sceneAnims[i] = &animationY;
+		  if (indirectMeshes.count(name)) sceneIndirect[i] = indirectMeshes[name];
+	  }
+	  ++sceneVersion; // cached frames are stale
+}
+
+//--------------------------------------------------------------
+void ofApp::bakeLightmaps() {
+
+	//Room surfaces, each projected onto its own plane with the lit side facing into the room
+	  lightmaps.clear();
+	  lightmaps.lights({ lighting::sceneLight(0), lighting::sceneLight(1), lighting::sceneLight(2) }).occlusion(32, 0.25);
+	  struct Wall { const char* name; ofMesh* mesh; vec3 front; };
+	  for (auto& w : { Wall{ "wall1", &wall1, vec3(0, 0, 1) }, Wall{ "wall2", &wall2, vec3(1, 0, 0) },
+		  Wall{ "wall3", &wall3, vec3(-1, 0, 0) }, Wall{ "floor", &floor, vec3(0, 1, 0) } })
+	  {
+		  int i = lightmaps.add(w.name, 128);
+		  lightmaps.addMesh(i, *w.mesh, mat4(1.));
+		  auto& v = w.mesh->getVertices(); // quad corners a, b, c, d; lightmap follows the texture co-ords
+		  lightmaps.project(i, LightmapBaker::planar(v[0], v[1] - v[0], v[3] - v[0], w.front));
+	  }
+
+	//Static scene instances: plate tops are baked from above, everything else occludes ambient light
+	  sceneLightmaps.assign(scene.size(), -1);
+	  for (uint32_t k = 0; k < scene.size(); ++k)
+	  {
+		  auto& inst = scene[k];
+		  auto model = inst.model < sceneModels.size() ? sceneModels[inst.model] : nullptr;
+		  auto anim = inst.anim < sceneAnims.size() ? sceneAnims[inst.anim] : nullptr;
+		  if (!model || anim) continue;
+		  auto transform = Scene::transform(inst) * mat4(model->getModelMatrix());
+		  int surface = model == &plate ? lightmaps.add("plate" + ofToString(k), 256, true) : -1;
+		  for (unsigned i = 0; i < model->getMeshCount(); ++i)
+		  {
+			  auto m = transform * mat4(model->getMeshHelper(i).matrix);
+			  if (surface >= 0) lightmaps.addMesh(surface, model->getMesh(i), m);
+			  else lightmaps.addOccluder(model->getMesh(i), m);
+		  }
+		  if (surface >= 0) lightmaps.projectTopDown(surface);
+		  sceneLightmaps[k] = surface;
+	  }
+
+	  lightmaps.bake("lightmaps");
+	  ++sceneVersion;
+}
+
+//--------------------------------------------------------------
+ShaderVariants::Program& ofApp::beginShader(ShaderVariants& variants, uint32_t flags) {
+
+	//Picks the variant for the flags and the current view mode, compiling it on first use
+	  auto& program = variants.get(flags | (views.size() ? MULTIVIEW : 0));
+	  program.begin();
+	  views.apply(&program.locations[VIEWS_UNIFORM]);
+	  return program;
+}
+
+//--------------------------------------------------------------
+void ofApp::drawScene(int layers) {
+
+	//GL 4.3: one multi-draw for the whole scene
+	  if (useIndirect)
+	  {
+		  drawSceneIndirect(layers);
+		  return;
+	  }
+
+	//Instances in the requested layers; animated ones are dynamic, the rest static
+	  auto visible = [&](const SceneInstance& inst) {
+		  auto model = inst.model < sceneModels.size() ? sceneModels[inst.model] : nullptr;
+		  int m = inst.material < sceneMaterials.size() ? sceneMaterials[inst.material] : NO_MATERIAL;
+		  auto anim = inst.anim < sceneAnims.size() ? sceneAnims[inst.anim] : nullptr;
+		  return model && m != NO_MATERIAL && (layers & (anim ? DYNAMIC_LAYER : STATIC_LAYER));
+	  };
+
+	//Transforms of every mesh part drawn, written to the object ring in one go
+	  size_t count = 0;
+	  for (auto& inst : scene)
+		  if (visible(inst))
+			  count += sceneMeshes[inst.model] ? sceneMeshes[inst.model]->parts().size() : sceneModels[inst.model]->getMeshCount();
+	  auto objects = frameArena.make<ObjectBlock>(count);
+	  size_t k = 0;
+	  for (auto& inst : scene)
+	  {
+		  if (!visible(inst)) continue;
+		  auto transform = Scene::transform(inst);
+		  if (auto anim = inst.anim < sceneAnims.size() ? sceneAnims[inst.anim] : nullptr) transform = glm::translate(mat4(1.), vec3(0, anim->para(), 0)) * transform;
+		  if (auto mesh = sceneMeshes[inst.model])
+			  for (auto& p : mesh->parts()) objects[k++].model = transform * mesh->modelMatrix() * p.matrix;
+		  else
+			  for (unsigned i = 0; i < sceneModels[inst.model]->getMeshCount(); ++i)
+				  objects[k++].model = transform * mat4(sceneModels[inst.model]->getModelMatrix()) * mat4(sceneModels[inst.model]->getMeshHelper(i).matrix);
+	  }
+	  size_t object = objectBlocks.write(objects, count);
+
+	//Instances are grouped by material, so shaders and textures only change between groups
+	  int n = views.instances();
+	  int material = NO_MATERIAL;
+	  uint32_t shaderFlags = 0;
+	  ShaderVariants::Program* shader = nullptr;
+	  for (auto& inst : scene)
+	  {
+		  if (!visible(inst)) continue;
+		  auto model = sceneModels[inst.model];
+		  int m = sceneMaterials[inst.material];
+
+		  //Baked instances sample their lightmap on the side it faces; the rest of the mesh is lit live
+		  size_t k = &inst - scene.begin();
+		  int lightmap = useLightmaps && k < sceneLightmaps.size() ? sceneLightmaps[k] : -1;
+		  uint32_t flags = (m == MIRROR ? REFLECTION : TEXTURED) | (lightmap >= 0 ? LIGHTMAPPED : 0);
+
+		  if (m != material || flags != shaderFlags)
+		  {
+			  //Minimal shader variant for the material
+			  if (!shader || flags != shaderFlags)
+			  {
+				  if (shader) shader->end();
+				  shader = &beginShader(litShaders, flags);
+				  shaderFlags = flags;
+			  }
+			  material = m;
+
+			  switch (m)
+			  {
+				  case ICING: shader->texture(TEX_UNIFORM, textures.get(vanillaCake ? "icing" : "icing2"), 0); break;
+				  case SPONGE: shader->texture(TEX_UNIFORM, textures.get(vanillaCake ? "sponge" : "chocolateSponge"), 0); break;
+				  case POLKADOT: shader->texture(TEX_UNIFORM, textures.get("polkaDot"), 0); break;
+				  case MIRROR:
+					  shader->texture(BACKGROUND_UNIFORM, textures.get("background"), 0);
+					  shader->set(DIFFUSE_UNIFORM, vec3(0.2, 0.4, 0.7));
+					  shader->set(REFLECTIVITY_UNIFORM, 0.7f);
+					  break;
+			  }
+			  shader->set(SHINE_UNIFORM, m == MIRROR ? 200.f : 100.f);
+		  }
+		  if (lightmap >= 0)
+		  {
+			  shader->texture(LIGHTMAP_UNIFORM, lightmaps.texture(lightmap), 1);
+			  shader->set(LIGHTMAP_MATRIX_UNIFORM, lightmaps.projection(lightmap));
+		  }
+
+		  //Each part binds its own transform; no matrix stack uploads
+		  if (auto mesh = sceneMeshes[inst.model])
+		  {
+			  for (size_t i = 0; i < mesh->parts().size(); ++i)
+			  {
+				  objectBlocks.bind(object++);
+				  mesh->drawPart(i, n);
+			  }
+		  }
+		  else
+		  {
+			  for (unsigned i = 0; i < model->getMeshCount(); ++i)
+			  {
+				  auto& helper = model->getMeshHelper(i);
+				  objectBlocks.bind(object++);
+				  helper.vbo.drawElementsInstanced(GL_TRIANGLES, helper.indices.size(), n);
+			  }
+		  }
+	  }
+	  if (shader) shader->end();
+}
+
+//--------------------------------------------------------------
+void ofApp::drawSceneIndirect(int layers) {
+
+	//Lists each instance's mesh parts as draws, with transform and material as per-draw data
+	  indirectScene.begin();
+	  for (auto& inst : scene)
+	  {
+		  int mesh = inst.model < sceneIndirect.size() ? sceneIndirect[inst.model] : -1;
+		  int m = inst.material < sceneMaterials.size() ? sceneMaterials[inst.material] : NO_MATERIAL;
+		  if (mesh < 0 || m == NO_MATERIAL) continue;
+		  auto anim = inst.anim < sceneAnims.size() ? sceneAnims[inst.anim] : nullptr;
+		  if (!(layers & (anim ? DYNAMIC_LAYER : STATIC_LAYER))) continue;
+
+		  auto transform = Scene::transform(inst);
+		  if (anim) transform = glm::translate(mat4(1.), vec3(0, anim->para(), 0)) * transform;
+
+		  //Texture array layers: icing, icing2, sponge, chocolateSponge, polkaDot
+		  switch (m)
+		  {
+			  case ICING: indirectScene.add(mesh, transform, vec4(1., 1., 1., vanillaCake ? 0 : 1), vec4(100., 0., 0., 0.)); break;
+			  case SPONGE: indirectScene.add(mesh, transform, vec4(1., 1., 1., vanillaCake ? 2 : 3), vec4(100., 0., 0., 0.)); break;
+			  case POLKADOT: indirectScene.add(mesh, transform, vec4(1., 1., 1., 4), vec4(100., 0., 0., 0.)); break;
+			  case MIRROR: indirectScene.add(mesh, transform, vec4(0.2, 0.4, 0.7, -1.), vec4(200., 0.7, 0., 0.)); break;
+		  }
+	  }
+
+	//Every material in one shader variant, so the whole list is one call; the plate stays lit live here
+	  auto& shader = beginShader(litShaders, INDIRECT | TEXTURED | REFLECTION);
+	  shader.texture(TEX_ARRAY_UNIFORM, GL_TEXTURE_2D_ARRAY, materialTextures.id(), 0);
+	  shader.texture(BACKGROUND_UNIFORM, textures.get("background"), 1);
+	  indirectScene.draw(views.instances());
+	  shader.end();
 }
 
 //--------------------------------------------------------------
@@ -694,6 +1096,51 @@ void ofApp::keyPressed(int key) {
 		song.play();
 	}
 
+	//Renders a turntable of catalogue views when 't' is pressed
+	if (key == 116)
+	{
+		turntableRequested = true;
+	}
+
+	//Shows frame time and render scale when 'f' is pressed
+	if (key == 102)
+	{
+		showStats = !showStats;
+	}
+
+	//Prints texture memory report when 'm' is pressed
+	if (key == 109)
+	{
+		std::cout << textures.report();
+	}
+
+	//Switches between multi-draw indirect and per-model drawing when 'i' is pressed (GL 4.3 only)
+	if (key == 105)
+	{
+		useIndirect = !useIndirect && indirectReady;
+		++sceneVersion;
+	}
+
+	//Pauses and resumes the slice animation when 's' is pressed
+	if (key == 115)
+	{
+		animating = !animating;
+	}
+
+	//Toggles heap allocation tracking when 'a' is pressed, printing the last frame's profile when turned off
+	if (key == 97)
+	{
+		Profiler::trackAllocations(!Profiler::trackingAllocations());
+		if (!Profiler::trackingAllocations()) std::cout << Profiler::report();
+	}
+
+	//Switches the walls, floor and plate between baked and live lighting when 'l' is pressed
+	if (key == 108)
+	{
+		useLightmaps = !useLightmaps;
+		++sceneVersion;
+	}
+
 
 }
 
@@ -735,6 +1182,8 @@ void ofApp::mouseExited(int x, int y) {
 //--------------------------------------------------------------
 void ofApp::windowResized(int w, int h) {
 
+	//Upscale quad is rebuilt for the new window size
+	screenQuad.clear();
 }
 
 //--------------------------------------------------------------
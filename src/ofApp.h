@@ -3,7 +3,20 @@
 #include "ofMain.h"
 #include "ofGraphicsUtil.h"
 #include "ofxAssimpModelLoader.h"
+#include "MeshBuilders.h"
+#include "MeshOptimizer.h"
+#include "MultiView.h"
+#include "Noise.h"
+#include "DynamicResolution.h"
+#include "FrameArena.h"
+#include "IndirectScene.h"
+#include "LightmapBaker.h"
 #include "PRamp.h"
+#include "Profiler.h"
+#include "SceneFile.h"
+#include "ShaderVariants.h"
+#include "TextureCache.h"
+#include "UniformBlocks.h"
 
 class ofApp : public ofBaseApp{
 
@@ -27,27 +40,31 @@ class ofApp : public ofBaseApp{
 		//Camera
 		ofEasyCam cam;
 
-		//Images
-		ofImage image;
-		ofImage image2;
-		ofImage image3;
-		ofImage image4;
-		ofImage image5;
-		ofImage image6;
-		ofImage background;
+		//Images (icing, polkaDot, sponge, paper, icing2, chocolateSponge, background)
+		TextureCache textures;
+		static const std::size_t textureBudget = 64 * 1024 * 1024;	// GPU bytes, material texture array included
 
-		//Shaders
-		ofShader textureShader;
-		ofShader mirrorShader;
-		ofShader pointShader;
+		//Shaders, compiled per combination of feature flags
+		enum ShaderFlag { TEXTURED = 1 << 0, VERTEX_COLOR = 1 << 1, REFLECTION = 1 << 2, MULTIVIEW = 1 << 3, INDIRECT = 1 << 4, LIGHTMAPPED = 1 << 5 };
+		ShaderVariants litShaders;
+		ShaderVariants spriteShaders;
+		ShaderVariants skyShaders;
+		ShaderVariants upscaleShader;	// one variant, for its link-time uniform locations
+		ShaderVariants::Program& beginShader(ShaderVariants& variants, uint32_t flags);
+
+		//Typed uniforms: locations resolved at link time; camera data and transforms in ring-buffered blocks
+		enum Uniform { TEX_UNIFORM, BACKGROUND_UNIFORM, TEX_ARRAY_UNIFORM, DIFFUSE_UNIFORM, SHINE_UNIFORM, REFLECTIVITY_UNIFORM, TEXTURING_UNIFORM, SPRITE_RADIUS_UNIFORM, LIGHTMAP_UNIFORM, LIGHTMAP_MATRIX_UNIFORM,
+			TEXEL_SIZE_UNIFORM, SHARPNESS_UNIFORM, VIEWS_UNIFORM /* MultiView::uniformNames() from here on */ };
+		UniformRing<FrameBlock> frameBlocks;
+		UniformRing<ObjectBlock> objectBlocks;
 
 		//Meshes
-		ofMesh wall1;
-		ofMesh wall2;
-		ofMesh wall3;
-		ofMesh floor;
-		ofMesh pointMesh;
-		ofMesh pointMesh2;
+		ofVboMesh wall1;
+		ofVboMesh wall2;
+		ofVboMesh wall3;
+		ofVboMesh floor;
+		ofVboMesh pointMesh;
+		ofVboMesh pointMesh2;
 	
 		//3D model meshes
 		ofxAssimpModelLoader mainCake;
@@ -63,11 +80,87 @@ class ofApp : public ofBaseApp{
 		//Textures
 		ofTexture noiseTex;
 
+		//Scene layout, bound by name to models, materials and animations
+		enum Material { ICING, SPONGE, POLKADOT, MIRROR, NO_MATERIAL = -1 };
+		Scene scene;
+		std::map<std::string, ofxAssimpModelLoader*> models;
+		std::map<std::string, OptimizedModel> optimizedModels;
+		std::vector<ofxAssimpModelLoader*> sceneModels;
+		std::vector<OptimizedModel*> sceneMeshes;
+		std::vector<int> sceneMaterials;
+		std::vector<PRamp*> sceneAnims;
+		int sceneVersion = 0;
+		void resolveScene();
+
+		//GL 4.3 path: merged model buffers drawn with one multi-draw indirect call
+		IndirectScene indirectScene;
+		TextureArray materialTextures;
+		std::map<std::string, int> indirectMeshes;
+		std::vector<int> sceneIndirect;
+		bool useIndirect = false;
+		bool indirectReady = false;	// merged buffers, texture array and shader all set up
+		void drawSceneIndirect(int layers);
+
+		//Baked diffuse lighting for the walls, floor and plate; surfaces 0-3 are wall1-3 and floor
+		LightmapBaker lightmaps;
+		std::vector<int> sceneLightmaps; // per scene instance, -1 if lit live
+		bool useLightmaps = true;
+		void bakeLightmaps();
+
+		//Drawing, split into what stays put (static) and what animates (dynamic)
+		enum Layer { STATIC_LAYER = 1, DYNAMIC_LAYER = 2, ALL_LAYERS = 3 };
+		void drawWorld(int layers = ALL_LAYERS);
+		void drawScene(int layers = ALL_LAYERS);
+		void drawRoom();
+		void drawSprites();
+
+		//Dynamic resolution: the scene is drawn into sceneFbo and upscaled to the window
+		DynamicResolution resolution;
+		ofFbo sceneFbo;
+		ofVboMesh screenQuad;
+		bool showStats = false;
+		std::string statsText;
+		ofBitmapFont statsFont;
+
+		//Idle-frame skipping: everything that shows in the scene, compared frame to frame
+		struct FrameState {
+			glm::mat4 view{1.f}, projection{1.f};
+			glm::ivec2 size{0};
+			int scene = -1;
+			bool vanilla = false;
+			float slice = 0.f;	// animated offset of the slice group
+			float flames = 0.f;	// candle flame offset, 0 when blown out
+			bool candles = false;
+
+			bool sameStatic(const FrameState& o) const {
+				return view == o.view && projection == o.projection && size == o.size && scene == o.scene && vanilla == o.vanilla;
+			}
+			bool operator==(const FrameState& o) const {
+				return sameStatic(o) && slice == o.slice && flames == o.flames && candles == o.candles;
+			}
+		};
+		FrameState frameState;
+		ofFbo staticFbo; // static layer, colour + depth
+		FrameState currentFrameState(glm::ivec2 size);
+
+		//Frame profiling: heap allocations per scope, and scratch memory released every frame
+		FrameArena frameArena;
+		int allocCheck = 0; // steady-state frames to check for allocations, set by --check-allocs
+		int allocCheckFailures = 0;
+		void checkAllocations();
+
+		//Multi-view rendering of catalogue turntables
+		MultiView views;
+		ofFbo turntableFbo;
+		bool turntableRequested = false;
+		void renderTurntable();
+
 		//Variables
 		float input;
 		float mappedSin;
 		bool candlesOn;
 		bool vanillaCake;
+		bool animating = true;
 
 		//Misc
 		PRamp animationY;
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <string>
 #include "ofShader.h"
 
@@ -29,8 +31,9 @@ static void scope(T& obj, const Func& f){
 /// @param[in] vs		Vertex program source
 /// @param[in] fs		Fragment program source
 /// @param[in] version	GLSL version to use for both programs
-static bool build(ofShader& s, const std::string& vs, const std::string& fs, const std::string& version = "150"){
-	auto preamble = "#version " + version + "\n";
+/// @param[in] defines	Preprocessor lines inserted after the version in both programs
+static bool build(ofShader& s, const std::string& vs, const std::string& fs, const std::string& version = "150", const std::string& defines = ""){
+	auto preamble = "#version " + version + "\n" + defines;
 	return
 		s.setupShaderFromSource(GL_VERTEX_SHADER, (preamble + vs).c_str()) &&
 		s.setupShaderFromSource(GL_FRAGMENT_SHADER, (preamble + fs).c_str()) &&